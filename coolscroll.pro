@@ -3,13 +3,30 @@
 
 DEFINES += COOLSCROLL_LIBRARY
 
+QT += concurrent
+
 # CoolScroll files
 
 SOURCES += coolscrollplugin.cpp \
     coolscrollbar.cpp \
     coolscrollbarsettings.cpp \
     settingspage.cpp \
-    settingsdialog.cpp
+    settingsdialog.cpp \
+    coolscrollmultisearch.cpp \
+    coolscrolltokenindex.cpp \
+    coolscrollmarkerlayer.cpp \
+    coolscrollhighlightcoverage.cpp \
+    coolscrollmetrics.cpp \
+    coolscrolldiff.cpp \
+    coolscrollrenderer.cpp \
+    coolscrolldocumentsnapshot.cpp \
+    coolscrolldiskcache.cpp \
+    coolscrollqualitygovernor.cpp \
+    coolscrollwrapmodel.cpp \
+    coolscrolltextcolumns.cpp \
+    coolscrollscheduler.cpp \
+    coolscrolllens.cpp \
+    coolscrolloutline.cpp
 
 HEADERS += coolscrollplugin.h\
         coolscroll_global.h\
@@ -17,7 +34,22 @@ HEADERS += coolscrollplugin.h\
     coolscrollbar.h \
     coolscrollbarsettings.h \
     settingspage.h \
-    settingsdialog.h
+    settingsdialog.h \
+    coolscrollmultisearch.h \
+    coolscrolltokenindex.h \
+    coolscrollmarkerlayer.h \
+    coolscrollhighlightcoverage.h \
+    coolscrollmetrics.h \
+    coolscrolldiff.h \
+    coolscrollrenderer.h \
+    coolscrolldocumentsnapshot.h \
+    coolscrolldiskcache.h \
+    coolscrollqualitygovernor.h \
+    coolscrollwrapmodel.h \
+    coolscrolltextcolumns.h \
+    coolscrollscheduler.h \
+    coolscrolllens.h \
+    coolscrolloutline.h
 
 # Qt Creator linking
 
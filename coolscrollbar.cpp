@@ -36,6 +36,10 @@
 #include <QtGui/QPainter>
 #include <QApplication>
 #include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTextCodec>
 
 #include <texteditor/texteditor.h>
 #include <texteditor/textdocument.h>
@@ -43,73 +47,193 @@
 #include <texteditor/fontsettings.h>
 #include <texteditor/texteditorconstants.h>
 #include <texteditor/textdocumentlayout.h>
+#include <texteditor/tabsettings.h>
 
 #include "coolscrollbarsettings.h"
-#include <QTime>
+#include "coolscrolllens.h"
+#include "coolscrollmetrics.h"
+#include "coolscrolltokenindex.h"
+#include <QElapsedTimer>
+
+#include <algorithm>
 
 namespace
 {
-    quint32 getLineNumberOfTextCursor(QTextCursor cursor)
-    {
-        cursor.movePosition(QTextCursor::StartOfLine);
+    const quint32 l_maxSymbolsPerLine = 100;
 
-        int lines = 1;
-        while(cursor.positionInBlock()>0) {
-            cursor.movePosition(QTextCursor::Up);
-            lines++;
-        }
-        QTextBlock block = cursor.block().previous();
+    const int l_maxHighlightTerms = 8;
+    const int l_termHueStep = 360 / l_maxHighlightTerms;
 
-        while(block.isValid()) {
-            lines += block.lineCount();
-            block = block.previous();
-        }
-        return lines;
-    }
+    // edits are diffed against the baseline after typing pauses for this long
+    const int l_diffDelay = 300;
+    // one scroll per frame while dragging
+    const int l_dragFrameInterval = 16;
+    // while resizing, the picture is scaled; it is rendered again once the size
+    // has not changed for this long
+    const int l_resizeSettleDelay = 150;
 
-    const qreal l_maxLineHeight = 2.0;
-    const quint32 l_maxSymbolsPerLine = 100;
-    const QString l_sampleString = "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX";
+    // maps categories of editor scroll bar highlights to our markers,
+    // returns false for ones which are not shown (e.g. current line)
+    bool markerCategory(const Core::Id& id, CoolScrollMarkerLayer::Category& category)
+    {
+        const QByteArray name = id.name();
+        if (name == TextEditor::Constants::SCROLL_BAR_SEARCH_RESULT)
+            category = CoolScrollMarkerLayer::FindResult;
+        else if (name.contains("Bookmark"))
+            category = CoolScrollMarkerLayer::Bookmark;
+        else if (name.contains("Breakpoint"))
+            category = CoolScrollMarkerLayer::Breakpoint;
+        else if (name.contains("Error"))
+            category = CoolScrollMarkerLayer::Error;
+        else if (name.contains("Warning"))
+            category = CoolScrollMarkerLayer::Warning;
+        else
+            return false;
+        return true;
+    }
 
 }
 
 CoolScrollBar::CoolScrollBar(TextEditor::TextEditorWidget *edit,
-                             QSharedPointer<CoolScrollbarSettings>& settings) :
+                             QSharedPointer<CoolScrollbarSettings>& settings,
+                             QSharedPointer<CoolScrollMetrics>& metrics,
+                             QSharedPointer<CoolScrollScheduler>& scheduler) :
     m_parentEdit(edit),
     m_settings(settings),
+    m_metrics(metrics),
+    m_scheduler(scheduler),
     m_yAdditionalScale(1.0),
+    m_searchGeneration(0),
+    m_snapshots(new CoolScrollSnapshotTracker(edit->document(), this)),
+    m_tokenIndex(new CoolScrollTokenIndex(m_snapshots, scheduler.data(), this)),
+    m_hasBaseline(false),
+    m_baselineRequested(false),
+    m_baselineGeneration(0),
+    m_diffGeneration(0),
     m_highlightNextSelection(false),
     m_leftButtonPressed(false),
-    m_renderData(nullptr)
+    m_dragPos(0.0),
+    m_dragPending(false),
+    m_dragEvents(0),
+    m_renderData(nullptr),
+    m_lens(nullptr),
+    m_shown(false)
 {
+    connect(&m_searchWatcher, &QFutureWatcher<CoolScrollSearchResult>::finished,
+                        this, &CoolScrollBar::highlightSearchFinished);
+    connect(m_tokenIndex, &CoolScrollTokenIndex::indexReady,
+                    this, &CoolScrollBar::tokenIndexReady);
+    m_tokenIndex->setEnabled(settings->tokenIndexEnabled || settings->highlightWordUnderCursor);
+
+    // highlights are imported once the editor has updated them, see scheduleMarkerImport()
+    m_markerImportTimer.setSingleShot(true);
+    m_markerImportTimer.setInterval(0);
+    connect(&m_markerImportTimer, &QTimer::timeout, this, &CoolScrollBar::importEditorMarkers);
+
+    m_diffTimer.setSingleShot(true);
+    m_diffTimer.setInterval(l_diffDelay);
+    connect(&m_diffTimer, &QTimer::timeout, this, &CoolScrollBar::startDiff);
+    connect(&m_diffWatcher, &QFutureWatcher<CoolScrollDiffResult>::finished,
+                      this, &CoolScrollBar::diffFinished);
+    // the baseline follows saves, reloads and renames of the file
+    TextEditor::TextDocument* textDocument = edit->textDocument();
+    connect(textDocument, &Core::IDocument::changed, this, &CoolScrollBar::documentStateChanged);
+    connect(textDocument, &Core::IDocument::reloadFinished, this, &CoolScrollBar::reloadBaseline);
+    connect(textDocument, &Core::IDocument::filePathChanged, this, &CoolScrollBar::reloadBaseline);
+
+    m_dragTimer.setSingleShot(true);
+    m_dragTimer.setInterval(l_dragFrameInterval);
+    connect(&m_dragTimer, &QTimer::timeout, this, &CoolScrollBar::dragFrameElapsed);
+    m_resizeTimer.setSingleShot(true);
+    m_resizeTimer.setInterval(l_resizeSettleDelay);
+    connect(&m_resizeTimer, &QTimer::timeout, this, &CoolScrollBar::resizeSettled);
+    // highlights are searched in the window of a scrolling minimap only
+    connect(this, &QScrollBar::valueChanged, this, &CoolScrollBar::windowMoved);
+    connect(&m_diskCacheWatcher, &QFutureWatcher<bool>::finished,
+                           this, &CoolScrollBar::diskCacheValidated);
+    connect(&m_prewarmWatcher, &QFutureWatcher<QImage>::finished,
+                         this, &CoolScrollBar::prewarmRendered);
 }
 
 CoolScrollBar::~CoolScrollBar()
 {
     if (m_renderData)
         delete m_renderData;
+
+    m_content.image = QImage();
+    accountContentMemory();
+
+    // results would have nobody to go to
+    m_scheduler->cancelAll(&m_searchWatcher);
+    m_scheduler->cancelAll(&m_diffWatcher);
+    m_scheduler->cancelAll(&m_diskCacheWatcher);
+    m_scheduler->cancelAll(&m_prewarmWatcher);
+    m_scheduler->cancelAll(this);
+    // pending stores of m_content are kept, they own copies of what they write
 }
 
 void CoolScrollBar::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event);
     if (!m_renderData) return;
 
     QPainter painter(this);
 
-    QTime time = QTime::currentTime();
-    // draw document picture
-    painter.fillRect(rect(), Qt::white);
-    drawDocumentPreview(painter, *m_parentEdit->textDocument());
+    QElapsedTimer timer;
+    timer.start();
+
+    updateYScale();
 
-    // draw selections
-    painter.setBrush(settings().selectionHighlightColor);
+    // draw document picture, it is rendered again only when out of date
+    const qreal dpr = devicePixelRatioF();
+    if (m_resizeTimer.isActive() && canScaleContent())
+    {
+        // line by line the old picture stretched to the new line height
+        const qreal scale = calculateLineHeight() / m_content.lineHeight;
+        const QImage& content = m_content.image;
+        painter.drawImage(QRectF(0, 0, width(), content.height() / content.devicePixelRatio() * scale), content);
+        m_metrics->addSample(QStringLiteral("resize.scaled_paints"), 1);
+    }
+    else
+    {
+        if (!contentUpToDate())
+        {
+            renderContent();
+        }
+        // the picture is kept palette indexed, only the exposed part is expanded to ARGB
+        const QRectF exposed(event->rect());
+        painter.drawImage(exposed, m_content.image,
+                          QRectF(exposed.topLeft() * dpr, exposed.size() * dpr));
+    }
+
+    // layers below show the same rows as the picture, the window of a
+    // scrolling minimap included
+    const qreal lineHeight = calculateLineHeight();
+    const int firstRow = firstVisibleRow();
+
+    // draw changes against baseline
+    m_changes.paint(painter, wrapModel(), lineHeight, firstRow, size());
+
+    // draw selections, each term with its own color; their pixel rows are
+    // for the old size until the resize settles, and for the old window
+    // until the search for the new one finishes
     painter.setPen(Qt::NoPen);
-    painter.drawRects(m_renderData->selectedAreas);
+    if (!m_resizeTimer.isActive())
+    {
+        QColor cursorWordColor = settings().selectionHighlightColor;
+        cursorWordColor.setAlpha(cursorWordColor.alpha() / 2);
+        paintHighlight(painter, m_renderData->cursorWordAreas, cursorWordColor, firstRow);
+        const int termsCount = qMin(m_renderData->selectedAreas.size(), m_highlightTerms.size());
+        for (int i = 0; i < termsCount; ++i)
+        {
+            paintHighlight(painter, m_renderData->selectedAreas[i], m_highlightTerms[i].color, firstRow);
+        }
+    }
+
+    // draw markers
+    m_markers.paint(painter, wrapModel(), lineHeight, firstRow, rect());
 
     // draw viewport rect
-    qreal lineHeight = calculateLineHeight();
-    QPointF rectPos(0, static_cast<qreal>(value() - 1) * lineHeight); // TODO: -1 is a magic number, check why drawContents is shifted
+    QPointF rectPos(0, static_cast<qreal>(valueToRow(value()) - firstRow) * lineHeight);
     QRectF rect(rectPos, QSizeF(settings().scrollBarWidth / getXScale(),
                                 static_cast<qreal>(linesInViewportCount()) * lineHeight));
 
@@ -118,25 +242,78 @@ void CoolScrollBar::paintEvent(QPaintEvent *event)
     painter.drawRect(rect);
 
     painter.end();
-    qDebug() << "render time = " << -QTime::currentTime().msecsTo(time);
+    m_metrics->addSample(QStringLiteral("paint.%1x.usec").arg(dpr), timer.nsecsElapsed() / 1000);
+}
+
+void CoolScrollBar::paintHighlight(QPainter& painter, const CoolScrollHighlightCoverage& areas,
+                                   const QColor& color, int firstRow) const
+{
+    // areas placed for an earlier window move along with the picture
+    const qreal offset = (areas.firstRow() - firstRow) * calculateLineHeight();
+    painter.translate(0, offset);
+    areas.paint(painter, color);
+    painter.translate(0, -offset);
 }
 
 int CoolScrollBar::unfoldedLinesCount() const
 {
     Q_ASSERT(m_parentEdit);
-    int res = 0;
-    QTextBlock b = originalDocument().firstBlock();
-    while(b != originalDocument().lastBlock())
+    return wrapModel().rowCount();
+}
+
+CoolScrollScheduler::Priority CoolScrollBar::jobPriority() const
+{
+    // only the current editor is active
+    if (m_renderData) return CoolScrollScheduler::ActiveEditor;
+    return isVisible() ? CoolScrollScheduler::VisibleEditor : CoolScrollScheduler::BackgroundEditor;
+}
+
+int CoolScrollBar::editorWrapColumn() const
+{
+    if (m_parentEdit->lineWrapMode() == QPlainTextEdit::NoWrap ||
+        m_parentEdit->wordWrapMode() == QTextOption::NoWrap)
     {
-        if(b.isVisible())
-        {
-            res += b.lineCount();
-        }
-        b = b.next();
+        return 0;
     }
-    qDebug() << "UNFOLDED LINES = " << res;
+    // the editor wraps at its viewport width, its font is monospace
+    const qreal charWidth = QFontMetricsF(m_parentEdit->font()).width(QLatin1Char('x'));
+    const qreal textWidth = m_parentEdit->viewport()->width() - 2 * originalDocument().documentMargin();
+    return qMax(1, int(textWidth / qMax(charWidth, 1.0)));
+}
+
+int CoolScrollBar::tabSize() const
+{
+    return m_parentEdit->textDocument()->tabSettings().m_tabSize;
+}
+
+const CoolScrollWrapModel& CoolScrollBar::wrapModel() const
+{
+    // cheap when neither the text nor the wrap column changed
+    m_wrap.update(m_snapshots->snapshot(), editorWrapColumn(), tabSize());
+    return m_wrap;
+}
+
+int CoolScrollBar::valueToRow(int value) const
+{
+    // the editor scrolls by lines of its own layout, the top block is
+    // found through them and the offset inside it is kept
+    const CoolScrollWrapModel& wrap = wrapModel();
+    const QTextBlock block = originalDocument().findBlockByLineNumber(value);
+    if (!block.isValid()) return wrap.rowCount();
+
+    const int offset = qBound(0, value - block.firstLineNumber(), qMax(0, wrap.rows(block.blockNumber()) - 1));
+    return wrap.firstRow(block.blockNumber()) + offset;
+}
+
+int CoolScrollBar::rowToValue(int row) const
+{
+    const CoolScrollWrapModel& wrap = wrapModel();
+    const int blockNumber = wrap.blockAt(row);
+    const QTextBlock block = originalDocument().findBlockByNumber(blockNumber);
+    if (!block.isValid()) return maximum();
 
-    return res;
+    const int offset = qBound(0, row - wrap.firstRow(blockNumber), qMax(0, block.lineCount() - 1));
+    return block.firstLineNumber() + offset;
 }
 
 int CoolScrollBar::linesInViewportCount() const
@@ -161,6 +338,7 @@ const QTextDocument& CoolScrollBar::originalDocument() const
 
 void CoolScrollBar::documentContentChanged()
 {
+    m_content.valid = false;
     update();
 }
 
@@ -168,28 +346,28 @@ void CoolScrollBar::documentSelectionChanged()
 {
     if(m_highlightNextSelection)
     {
+        // handle only the selection made by this double click
+        m_highlightNextSelection = false;
         QString selectedStr = m_parentEdit->textCursor().selection().toPlainText();
-        // clear previous highlight
-        clearHighlight();
-        m_stringToHighlight = selectedStr;
-        // highlight new selection
-        highlightEntryInDocument(m_stringToHighlight);
-
-        update();
+        toggleHighlightTerm(selectedStr);
     }
 }
 
 void CoolScrollBar::documentSizeChanged(const QSizeF)
 {
     qDebug() << __PRETTY_FUNCTION__;
+    m_changes.invalidate();
     if (!m_renderData) return;
 
+    m_content.valid = false;
+    // highlights are laid out at the line height and window of the new size
+    updateYScale();
+
     if (hasHighlight())
     {
-        m_renderData->selectedAreas.clear();
-        highlightEntryInDocument(m_stringToHighlight);
-        update();
+        highlightTermsInDocument();
     }
+    documentCursorPositionChanged();
 }
 
 bool CoolScrollBar::eventFilter(QObject *obj, QEvent *e)
@@ -197,36 +375,314 @@ bool CoolScrollBar::eventFilter(QObject *obj, QEvent *e)
     if(obj == m_parentEdit->viewport())
     {
         m_highlightNextSelection = (e->type() == QEvent::MouseButtonDblClick);
+        // the editor repaints when it shows new search results
+        if (e->type() == QEvent::Paint)
+        {
+            scheduleMarkerImport();
+        }
     }
     return false;
 }
 
-void CoolScrollBar::drawDocumentPreview(QPainter &p, const TextEditor::TextDocument& document)
+void CoolScrollBar::updateFont()
 {
-    if (!m_renderData) return;
+    const qreal lineHeight = calculateLineHeight();
+    if (m_renderData->fontLineHeight == lineHeight && m_renderData->fontWidth == width()) return;
+
+    m_renderData->font = CoolScrollRenderer::fitFont(m_renderData->font, lineHeight, width(),
+                                                     &m_renderData->charWidth);
+    m_renderData->fontLineHeight = lineHeight;
+    m_renderData->fontWidth = width();
+}
+
+CoolScrollRenderParams CoolScrollBar::renderParams(const CoolScrallBarRenderData& data) const
+{
+    CoolScrollRenderParams params;
+    params.size = size();
+    params.devicePixelRatio = devicePixelRatioF();
+    params.lineHeight = calculateLineHeight();
+    params.firstRow = firstVisibleRow();
+    params.font = data.font;
+    params.charWidth = data.charWidth;
+    params.tabSize = tabSize();
+    params.quality = m_quality.detail();
+    params.outlineGap = settings().outlineGap;
+    return params;
+}
+
+bool CoolScrollBar::contentUpToDate() const
+{
+    const qreal dpr = devicePixelRatioF();
+    const QImage& content = m_content.image;
+    return m_content.valid && m_content.generation == settings().geometryGeneration
+            && m_content.revision == m_snapshots->snapshot().revision()
+            && m_content.wrapGeneration == wrapModel().generation()
+            && m_content.firstRow == firstVisibleRow()
+            && content.size() == size() * dpr && content.devicePixelRatio() == dpr;
+}
+
+bool CoolScrollBar::canScaleContent() const
+{
+    // a picture of other text or settings would be wrong, not just blurred
+    return m_content.valid && !m_content.image.isNull() && m_content.lineHeight > 0
+            && m_content.generation == settings().geometryGeneration
+            && m_content.revision == m_snapshots->snapshot().revision()
+            && m_content.firstRow == firstVisibleRow();
+}
+
+void CoolScrollBar::renderContent()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    updateFont();
+    const CoolScrollRenderParams params = renderParams(*m_renderData);
+    if (loadCachedContent(params))
+    {
+        m_metrics->addSample(QStringLiteral("disk_cache.load.usec"), timer.nsecsElapsed() / 1000);
+        return;
+    }
+
+    CoolScrollRenderStats stats;
+    const CoolScrollDocumentSnapshot snapshot = m_snapshots->snapshot();
+    const CoolScrollWrapModel& wrap = wrapModel();
+    m_content.image = CoolScrollRenderer::render(snapshot, wrap, params, &stats);
+    m_content.valid = true;
+    m_content.revision = snapshot.revision();
+    m_content.wrapGeneration = wrap.generation();
+    m_content.generation = settings().geometryGeneration;
+    m_content.lineHeight = params.lineHeight;
+    m_content.firstRow = params.firstRow;
+    m_content.fromDiskCache = false;
+    accountContentMemory();
+    storeCachedContent(params);
+
+    // 1x and 2x screens are accounted separately
+    const qint64 elapsed = timer.nsecsElapsed() / 1000;
+    m_metrics->addSample(QStringLiteral("render.%1x.usec").arg(params.devicePixelRatio), elapsed);
+    m_metrics->addSample(QStringLiteral("render.bands"), stats.bands);
+    m_metrics->addSample(QStringLiteral("render.band.max_usec"), stats.maxBandUsec);
+    // sum of band times over wall time, close to the core count when bands scale
+    if (elapsed > 0)
+    {
+        m_metrics->addSample(QStringLiteral("render.parallelism_pct"), 100 * stats.bandUsec / elapsed);
+    }
+    m_metrics->setValue(QStringLiteral("render.band_rows"), CoolScrollRenderer::bandRows());
+    const CoolScrollRenderer::Detail detail = CoolScrollRenderer::detail(params);
+
+    // a different detail is drawn with the next paint
+    m_metrics->setValue(QStringLiteral("quality.detail"), detail);
+    m_metrics->setValue(QStringLiteral("quality.last_usec"), elapsed);
+    if (m_quality.addFrame(detail, elapsed, qint64(settings().frameBudget) * 1000))
+    {
+        m_metrics->addSample(QStringLiteral("quality.switches"), 1);
+        m_content.valid = false;
+        update();
+    }
+}
+
+void CoolScrollBar::accountContentMemory()
+{
+    const qint64 bytes = m_content.image.byteCount();
+    // what the same picture would take as ARGB, to see the saving
+    const qint64 argbBytes = qint64(m_content.image.width()) * m_content.image.height() * 4;
+    m_metrics->addValue(QStringLiteral("memory.minimap.bytes"), bytes - m_content.accountedBytes);
+    m_metrics->addValue(QStringLiteral("memory.minimap.argb_bytes"), argbBytes - m_content.accountedArgbBytes);
+    m_content.accountedBytes = bytes;
+    m_content.accountedArgbBytes = argbBytes;
+}
+
+bool CoolScrollBar::loadCachedContent(const CoolScrollRenderParams& params)
+{
+    // only the first picture after opening comes from disk, later ones follow edits
+    // entries are pictures of the top of a document
+    if (!settings().diskCacheEnabled || m_content.diskCacheChecked || params.firstRow != 0) return false;
+    m_content.diskCacheChecked = true;
+    if (m_parentEdit->textDocument()->isModified()) return false;
+
+    const CoolScrollDiskCache cache(settings().diskCacheDirectory);
+    const CoolScrollDiskCacheKey key = CoolScrollDiskCache::key(
+                m_parentEdit->textDocument()->filePath().toString(), params, wrapModel().wrapColumn());
+    quint64 contentHash = 0;
+    const QImage image = cache.load(key, &contentHash);
+    if (image.isNull())
+    {
+        m_metrics->addSample(QStringLiteral("disk_cache.miss"), 1);
+        return false;
+    }
+    m_metrics->addSample(QStringLiteral("disk_cache.hit"), 1);
+
+    // shown right away, the text it was drawn from is compared on a worker
+    const CoolScrollDocumentSnapshot snapshot = m_snapshots->snapshot();
+    m_content.image = image;
+    m_content.valid = true;
+    m_content.revision = snapshot.revision();
+    m_content.generation = settings().geometryGeneration;
+    m_content.lineHeight = params.lineHeight;
+    m_content.firstRow = params.firstRow;
+    m_content.wrapGeneration = wrapModel().generation();
+    m_content.fromDiskCache = true;
+    m_content.storedKey = key;
+    accountContentMemory();
+
+    // the rows drawn are hashed, so folding or restored changes fail the check
+    const CoolScrollWrapModel wrap = wrapModel();
+    const int maxLines = CoolScrollRenderer::maxLines(params);
+    m_diskCacheWatcher.setFuture(m_scheduler->run(jobPriority(), &m_diskCacheWatcher, snapshot.revision(),
+                                                  [snapshot, wrap, maxLines, contentHash]()
+    {
+        return CoolScrollDiskCache::contentHash(wrap.rowTexts(snapshot, maxLines)) == contentHash;
+    }));
+    return true;
+}
+
+void CoolScrollBar::storeCachedContent(const CoolScrollRenderParams& params)
+{
+    if (!settings().diskCacheEnabled || m_parentEdit->textDocument()->isModified() || params.firstRow != 0) return;
+
+    const CoolScrollDiskCacheKey key = CoolScrollDiskCache::key(
+                m_parentEdit->textDocument()->filePath().toString(), params, wrapModel().wrapColumn());
+    if (!key.isValid() || key == m_content.storedKey) return;
+    m_content.storedKey = key;
+
+    // hashing and writing happen on a worker, the image is shared, not copied
+    const CoolScrollDiskCache cache(settings().diskCacheDirectory);
+    const CoolScrollDocumentSnapshot snapshot = m_snapshots->snapshot();
+    const CoolScrollWrapModel wrap = wrapModel();
+    const int maxLines = CoolScrollRenderer::maxLines(params);
+    const QImage image = m_content.image;
+    // a store of an older picture still waiting for a worker is dropped
+    m_scheduler->cancelStale(&m_content, snapshot.revision());
+    m_scheduler->run(CoolScrollScheduler::BackgroundEditor, &m_content, snapshot.revision(),
+                     [cache, key, snapshot, wrap, maxLines, image]()
+    {
+        cache.store(key, CoolScrollDiskCache::contentHash(wrap.rowTexts(snapshot, maxLines)), image);
+    });
+}
+
+void CoolScrollBar::diskCacheValidated()
+{
+    if (!m_content.fromDiskCache || m_diskCacheWatcher.isCanceled()) return;
 
-    QTextBlock block = document.document()->firstBlock();
-    qreal yPos = 0;
-    qreal lineHeight = calculateLineHeight();
-    qDebug() << "LH = " << lineHeight;
-    m_renderData->font.setPointSizeF(lineHeight);
-    QFontMetricsF fm(m_renderData->font);
+    m_content.fromDiskCache = false;
+    if (!m_diskCacheWatcher.result())
+    {
+        // e.g. restored unsaved changes or a different folding
+        m_metrics->addSample(QStringLiteral("disk_cache.stale"), 1);
+        m_content.valid = false;
+        m_content.storedKey = CoolScrollDiskCacheKey();
+        update();
+    }
+}
 
-    if (fm.width(l_sampleString) < width())
+bool CoolScrollBar::prewarm()
+{
+    if (m_renderData) return false;
+
+    // the active editor renders while painting, a hidden one needs its geometry;
+    // the layout keeps this size on show when the estimate was right
+    if (!m_shown && size() != layoutSize())
     {
-        m_renderData->font.setStretch(100 * width() / fm.width(l_sampleString));
+        resize(layoutSize());
+    }
+    updateYScale();
+    if (size().isEmpty() || contentUpToDate()) return false;
+    if (m_prewarmWatcher.isRunning()) return true;
+
+    CoolScrallBarRenderData data;
+    data.font = CoolScrollRenderer::fitFont(data.font, calculateLineHeight(), width(), &data.charWidth);
+    const CoolScrollRenderParams params = renderParams(data);
+    if (!CoolScrollRenderer::threadSafe(params)) return false;
+    // a picture from disk is shown right away, as on activation
+    if (loadCachedContent(params))
+    {
+        m_metrics->addSample(QStringLiteral("prewarm.disk_cache"), 1);
+        return false;
     }
-    p.setFont(m_renderData->font);
 
-    while (block.isValid())
+    const CoolScrollDocumentSnapshot snapshot = m_snapshots->snapshot();
+    const CoolScrollWrapModel wrap = wrapModel();
+    m_prewarmed = CoolScrollContentCache();
+    m_prewarmed.revision = snapshot.revision();
+    m_prewarmed.wrapGeneration = wrap.generation();
+    m_prewarmed.generation = settings().geometryGeneration;
+    m_prewarmed.lineHeight = params.lineHeight;
+    m_prewarmed.firstRow = params.firstRow;
+    m_prewarmWatcher.setFuture(m_scheduler->run(CoolScrollScheduler::Prewarm, &m_prewarmWatcher,
+                                                snapshot.revision(), [snapshot, wrap, params]()
     {
-        if (block.isVisible())
+        return CoolScrollRenderer::render(snapshot, wrap, params, nullptr);
+    }));
+    return true;
+}
+
+void CoolScrollBar::cancelPrewarm()
+{
+    // a render already running is finished, there is no point in stopping it halfway
+    m_scheduler->cancelAll(&m_prewarmWatcher);
+}
+
+void CoolScrollBar::prewarmRendered()
+{
+    if (!m_prewarmWatcher.isCanceled())
+    {
+        // dropped when the text, wrap or settings changed in the meantime
+        const QImage image = m_prewarmWatcher.result();
+        const qreal dpr = devicePixelRatioF();
+        if (!contentUpToDate() && m_prewarmed.revision == m_snapshots->snapshot().revision()
+                && m_prewarmed.wrapGeneration == wrapModel().generation()
+                && m_prewarmed.generation == settings().geometryGeneration
+                && m_prewarmed.firstRow == firstVisibleRow()
+                && image.size() == size() * dpr)
+        {
+            m_content.image = image;
+            m_content.valid = true;
+            m_content.revision = m_prewarmed.revision;
+            m_content.wrapGeneration = m_prewarmed.wrapGeneration;
+            m_content.generation = m_prewarmed.generation;
+            m_content.lineHeight = m_prewarmed.lineHeight;
+            m_content.firstRow = m_prewarmed.firstRow;
+            m_content.fromDiskCache = false;
+            accountContentMemory();
+            m_metrics->addSample(QStringLiteral("prewarm.rendered"), 1);
+        }
+        else
         {
-            p.drawText(QPointF(0.0, yPos), block.text());
-            yPos += lineHeight;
+            m_metrics->addSample(QStringLiteral("prewarm.stale"), 1);
         }
-        block = block.next();
     }
+    emit prewarmFinished();
+}
+
+qint64 CoolScrollBar::contentBytes() const
+{
+    return m_content.image.byteCount();
+}
+
+qint64 CoolScrollBar::expectedContentBytes() const
+{
+    // one byte per physical pixel, the picture is palette indexed
+    const qreal dpr = devicePixelRatioF();
+    const QSize size = layoutSize();
+    return qint64(size.width() * dpr) * qint64(size.height() * dpr);
+}
+
+QSize CoolScrollBar::layoutSize() const
+{
+    if (m_shown) return size();
+
+    // the bar takes the height of the editor inside its frame
+    const int frame = m_parentEdit->frameWidth();
+    return QSize(settings().scrollBarWidth, qMax(0, m_parentEdit->height() - 2 * frame));
+}
+
+void CoolScrollBar::releaseContent()
+{
+    if (m_renderData) return;
+
+    m_content.image = QImage();
+    m_content.valid = false;
+    accountContentMemory();
 }
 
 qreal CoolScrollBar::getXScale() const
@@ -236,73 +692,464 @@ qreal CoolScrollBar::getXScale() const
 
 qreal CoolScrollBar::calculateLineHeight() const
 {
-    qreal lineHeight = static_cast<float>(height()) / unfoldedLinesCount();
-    if (lineHeight > l_maxLineHeight)
+    // a scrolling minimap keeps the line height of short documents for long ones
+    if (settings().scrollingMinimap) return CoolScrollRenderer::maxLineHeight();
+    return CoolScrollRenderer::lineHeight(height(), unfoldedLinesCount());
+}
+
+void CoolScrollBar::updateYScale()
+{
+    // share of the document rows the bar has room for; below 1.0 the picture
+    // is a window of rows which scrolls along with the editor
+    const qreal documentHeight = unfoldedLinesCount() * calculateLineHeight();
+    m_yAdditionalScale = documentHeight > height() ? height() / documentHeight : 1.0;
+}
+
+int CoolScrollBar::firstVisibleRow() const
+{
+    if (m_yAdditionalScale >= 1.0 || maximum() <= minimum()) return 0;
+
+    // at the top of the editor the window shows the start of the document, at
+    // the bottom its end, proportionally in between, as the slider moves
+    const int hiddenRows = unfoldedLinesCount() - int(height() / calculateLineHeight());
+    const qreal fraction = qreal(value() - minimum()) / (maximum() - minimum());
+    return qMax(0, qRound(hiddenRows * fraction));
+}
+
+void CoolScrollBar::highlightTermsInDocument()
+{
+    ++m_searchGeneration;
+    if (!m_renderData) return;
+
+    if (m_highlightTerms.isEmpty())
+    {
+        m_renderData->selectedAreas.clear();
+        return;
+    }
+
+    updateFont();
+    CoolScrollSearchInput input = searchGeometry();
+    input.generation = m_searchGeneration;
+    input.terms = m_highlightTerms;
+
+    // whole word terms are looked up in the index, only the rest needs a scan;
+    // both find the same matches, see CoolScrollHighlightTerm
+    bool needScan = false;
+    m_renderData->selectedAreas.resize(m_highlightTerms.size());
+    m_termsResolvedByIndex.fill(false, m_highlightTerms.size());
+    for (int i = 0; i < m_highlightTerms.size(); ++i)
+    {
+        const CoolScrollHighlightTerm& term = m_highlightTerms[i];
+        if (m_tokenIndex->isReady() && !term.isRegExp() && term.wholeWord)
+        {
+            m_renderData->selectedAreas[i] = tokenAreas(term.text);
+            m_termsResolvedByIndex[i] = true;
+            input.terms[i].text.clear();
+        }
+        else
+        {
+            needScan = true;
+        }
+    }
+    if (!needScan)
+    {
+        update();
+        return;
+    }
+
+    // searches for older terms or text still waiting for a worker are dropped
+    m_scheduler->cancelStale(&m_searchWatcher, m_searchGeneration);
+    m_searchWatcher.setFuture(m_scheduler->run(jobPriority(), &m_searchWatcher, m_searchGeneration,
+                                               [input]() { return coolScrollSearch(input); }));
+}
+
+void CoolScrollBar::highlightSearchFinished()
+{
+    if (m_searchWatcher.isCanceled()) return;
+
+    const CoolScrollSearchResult result = m_searchWatcher.result();
+    if (!m_renderData || result.generation != m_searchGeneration) return;
+
+    for (int i = 0; i < result.areas.size() && i < m_renderData->selectedAreas.size(); ++i)
+    {
+        if (!m_termsResolvedByIndex.value(i))
+        {
+            m_renderData->selectedAreas[i] = result.areas[i];
+        }
+    }
+    m_metrics->addSample(QStringLiteral("search.terms"), m_highlightTerms.size());
+    update();
+
+    // the text was edited while the worker searched
+    if (result.revision != m_snapshots->revision())
     {
-        lineHeight = l_maxLineHeight;
+        highlightTermsInDocument();
     }
-    return lineHeight;
 }
 
-void CoolScrollBar::highlightEntryInDocument(const QString& stringToHighlight)
+CoolScrollSearchInput CoolScrollBar::searchGeometry() const
+{
+    CoolScrollSearchInput input;
+    input.snapshot = m_snapshots->snapshot();
+    input.wrap = wrapModel();
+    input.charWidth = m_renderData->charWidth;
+    input.lineHeight = calculateLineHeight();
+    input.minSelectionHeight = settings().m_minSelectionHeight;
+    input.scrollBarWidth = settings().scrollBarWidth;
+    input.visibleColumns = CoolScrollRenderer::visibleColumns(width(), m_renderData->charWidth);
+    input.height = height();
+    input.firstRow = firstVisibleRow();
+    return input;
+}
+
+CoolScrollHighlightCoverage CoolScrollBar::tokenAreas(const QString& token) const
 {
-    if(stringToHighlight.isEmpty() || !m_renderData)
+    QVector<CoolScrollSearchMatch> matches;
+    m_tokenIndex->occurrences(token, 0, matches);
+
+    const CoolScrollSearchInput geometry = searchGeometry();
+    CoolScrollHighlightCoverage areas(geometry.height, geometry.firstRow);
+
+    for (const CoolScrollSearchMatch& match : matches)
+    {
+        // the wrap model keeps rows, no need to walk previous blocks
+        if (geometry.wrap.rows(match.block) > 0)
+        {
+            areas.add(coolScrollMatchRect(geometry, geometry.snapshot.text(match.block), match));
+        }
+    }
+    return areas;
+}
+
+void CoolScrollBar::documentCursorPositionChanged()
+{
+    if (!m_renderData) return;
+
+    if (!settings().highlightWordUnderCursor || !m_tokenIndex->isReady())
     {
+        m_renderData->cursorWordAreas = CoolScrollHighlightCoverage();
         return;
     }
-    m_renderData->selectedAreas.clear();
-    m_renderData->selectedAreas.reserve(50);
-    auto document = m_parentEdit->document();
-    QTextCursor cur_cursor(document);
-    int numIter = 0;
-    while(true)
+
+    updateFont();
+    QTextCursor cursor = m_parentEdit->textCursor();
+    cursor.select(QTextCursor::WordUnderCursor);
+    const QString word = cursor.selectedText();
+    if (CoolScrollTokenIndex::isIdentifier(word))
     {
-        if (cur_cursor.isNull())
-            break;
+        m_renderData->cursorWordAreas = tokenAreas(word);
+    }
+    else
+    {
+        m_renderData->cursorWordAreas = CoolScrollHighlightCoverage();
+    }
+    update();
+}
+
+void CoolScrollBar::setMarkers(CoolScrollMarkerLayer::Category category, const QVector<int>& blocks)
+{
+    m_markers.setMarkers(category, blocks);
+    update();
+}
 
-        cur_cursor = document->find(stringToHighlight, cur_cursor);
-        if(!cur_cursor.isNull())
+void CoolScrollBar::addMarkers(CoolScrollMarkerLayer::Category category, const QVector<int>& blocks)
+{
+    m_markers.addMarkers(category, blocks);
+    update();
+}
+
+void CoolScrollBar::clearMarkers(CoolScrollMarkerLayer::Category category)
+{
+    m_markers.clearMarkers(category);
+    update();
+}
+
+void CoolScrollBar::scheduleMarkerImport()
+{
+    // the editor fills its controller from a queued call as well, ours runs after it
+    if (!m_markerImportTimer.isActive())
+    {
+        m_markerImportTimer.start();
+    }
+}
+
+void CoolScrollBar::importEditorMarkers()
+{
+    // highlights collected by editor for its own scroll bar are shown in the
+    // marker layer, its overlay must not be attached to our scroll bar
+    Core::HighlightScrollBarController* controller = m_parentEdit->highlightScrollBarController();
+    if (!controller) return;
+
+    if (controller->scrollArea())
+    {
+        controller->setScrollArea(nullptr);
+    }
+
+    const QHash<Core::Id, QVector<Core::Highlight>> highlights = controller->highlights();
+    if (highlights.isSharedWith(m_importedHighlights)) return;
+    m_importedHighlights = highlights;
+
+    QVector<int> blocks[CoolScrollMarkerLayer::CategoryCount];
+    for (auto it = highlights.constBegin(); it != highlights.constEnd(); ++it)
+    {
+        CoolScrollMarkerLayer::Category category;
+        if (!markerCategory(it.key(), category)) continue;
+
+        for (const Core::Highlight& highlight : it.value())
         {
-            QRectF selectionRect;
-            // calculate bounding rect for selected word
-            int blockPos = cur_cursor.block().position();
-
-            auto lineNumber = getLineNumberOfTextCursor(cur_cursor);
-
-            QFontMetricsF fm(m_renderData->font);
-            qreal left = fm.width(cur_cursor.block().text().mid(0, cur_cursor.selectionStart() - blockPos));
-            if (left > settings().scrollBarWidth)
-            {
-                left = settings().scrollBarWidth - fm.width(m_stringToHighlight);
-            }
-            selectionRect.setLeft(left);
-            selectionRect.setWidth(fm.width(m_stringToHighlight));
-
-            auto lineHeight = calculateLineHeight();
-            selectionRect.setTop(lineHeight * (lineNumber - 2));
-            // apply minimum selection height for good visibility in large files
-            if(lineHeight < settings().m_minSelectionHeight)
-            {
-                lineHeight = settings().m_minSelectionHeight;
-            }
-            selectionRect.setHeight(lineHeight);
-
-
-            qDebug() << "rect = " << selectionRect;
-            m_renderData->selectedAreas.push_back(selectionRect);
+            blocks[category].push_back(highlight.position);
         }
-        // prevents UI freezing
-        ++numIter;
-        if(numIter % 15 == 0)
+    }
+    for (int category = 0; category < CoolScrollMarkerLayer::CategoryCount; ++category)
+    {
+        m_markers.setMarkers(CoolScrollMarkerLayer::Category(category), blocks[category]);
+    }
+    update();
+}
+
+void CoolScrollBar::setBaselineText(const QString& text)
+{
+    m_baselineLines = coolScrollSplitLines(text);
+    m_hasBaseline = true;
+    startDiff();
+}
+
+void CoolScrollBar::documentStateChanged()
+{
+    // saved or reverted, the file on disk may be the baseline
+    if (!m_parentEdit->textDocument()->isModified())
+    {
+        reloadBaseline();
+    }
+}
+
+void CoolScrollBar::reloadBaseline()
+{
+    // a baseline never requested is loaded when change bars are shown
+    if (m_baselineRequested)
+    {
+        loadBaseline();
+    }
+}
+
+void CoolScrollBar::loadBaseline()
+{
+    m_baselineRequested = true;
+    // results of an earlier load still running are dropped
+    const int generation = ++m_baselineGeneration;
+    const QString filePath = m_parentEdit->textDocument()->filePath().toString();
+    if (filePath.isEmpty()) return;
+
+    // last committed version if the file is under git, saved file otherwise
+    const QFileInfo fileInfo(filePath);
+    QProcess* git = new QProcess(this);
+    git->setWorkingDirectory(fileInfo.absolutePath());
+    connect(git, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, [this, git, filePath, generation](int exitCode, QProcess::ExitStatus exitStatus)
+    {
+        git->deleteLater();
+        if (generation != m_baselineGeneration) return;
+
+        if (exitStatus == QProcess::NormalExit && exitCode == 0)
+        {
+            setBaselineText(decodeBaseline(git->readAllStandardOutput()));
+        }
+        else
+        {
+            loadBaselineFromDisk(filePath, generation);
+        }
+    });
+    connect(git, &QProcess::errorOccurred, this, [this, git, filePath, generation](QProcess::ProcessError error)
+    {
+        if (error != QProcess::FailedToStart) return;
+
+        git->deleteLater();
+        if (generation == m_baselineGeneration)
+        {
+            loadBaselineFromDisk(filePath, generation);
+        }
+    });
+    git->start(QStringLiteral("git"), { QStringLiteral("show"),
+                                        QStringLiteral("HEAD:./") + fileInfo.fileName() });
+}
+
+void CoolScrollBar::loadBaselineFromDisk(const QString& filePath, int generation)
+{
+    auto watcher = new QFutureWatcher<QByteArray>(this);
+    connect(watcher, &QFutureWatcher<QByteArray>::finished, this, [this, watcher, generation]()
+    {
+        watcher->deleteLater();
+        if (watcher->isCanceled() || generation != m_baselineGeneration) return;
+
+        const QByteArray data = watcher->result();
+        if (!data.isNull())
         {
-            qApp->processEvents();
+            setBaselineText(decodeBaseline(data));
         }
+    });
+    watcher->setFuture(m_scheduler->run(jobPriority(), this, 0, [filePath]()
+    {
+        QFile file(filePath);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }));
+}
+
+QString CoolScrollBar::decodeBaseline(const QByteArray& data) const
+{
+    const QTextCodec* codec = m_parentEdit->textDocument()->codec();
+    return codec ? codec->toUnicode(data) : QString::fromUtf8(data);
+}
+
+void CoolScrollBar::documentBlocksReplaced(int first, int removed, int added)
+{
+    // move existing bars and markers along with the text until the worker
+    // reports a new diff and the editor its new highlights
+    m_markers.blocksReplaced(first, removed, added);
+    if (m_hasBaseline && settings().showVcsChanges)
+    {
+        m_changes.applyEdit(first, first + removed - 1, first + added - 1);
+        m_diffTimer.start();
     }
-    qDebug() << "m_renderData->selectedAreas.size() = " << m_renderData->selectedAreas.size();
+}
+
+void CoolScrollBar::documentVisibilityChanged(int first, int count)
+{
+    // reported while a snapshot is taken, e.g. during painting
+    m_markers.visibilityChanged(first, count);
+}
+
+void CoolScrollBar::startDiff()
+{
+    ++m_diffGeneration;
+    if (!m_hasBaseline || !settings().showVcsChanges) return;
+
+    // lines are taken from the snapshot on the worker
+    const QVector<QString> baseline = m_baselineLines;
+    const CoolScrollDocumentSnapshot current = m_snapshots->snapshot();
+    const int generation = m_diffGeneration;
+    m_scheduler->cancelStale(&m_diffWatcher, generation);
+    m_diffWatcher.setFuture(m_scheduler->run(jobPriority(), &m_diffWatcher, generation,
+                                             [baseline, current, generation]()
+    {
+        return coolScrollDiff(baseline, current.texts(), generation);
+    }));
+}
+
+void CoolScrollBar::diffFinished()
+{
+    if (m_diffWatcher.isCanceled()) return;
+
+    const CoolScrollDiffResult result = m_diffWatcher.result();
+    if (result.generation != m_diffGeneration) return;
+
+    m_metrics->addSample(QStringLiteral("diff.usec"), result.elapsed);
+    m_metrics->addSample(QStringLiteral("diff.lines"), originalDocument().blockCount());
+
+    m_changes.setHunks(result.hunks);
+    update();
+}
+
+void CoolScrollBar::tokenIndexReady()
+{
+    highlightTermsInDocument();
+    documentCursorPositionChanged();
+}
+
+void CoolScrollBar::addHighlightTerm(const QString& text, const QColor& color, bool wholeWord)
+{
+    if (text.isEmpty()) return;
+
+    CoolScrollHighlightTerm term;
+    term.text = text;
+    term.wholeWord = wholeWord && CoolScrollTokenIndex::isIdentifier(text);
+    term.color = color.isValid() ? color : nextTermColor();
+    if (m_highlightTerms.size() >= l_maxHighlightTerms)
+    {
+        m_highlightTerms.removeFirst();
+    }
+    m_highlightTerms.push_back(term);
+    highlightTermsInDocument();
+    update();
+}
+
+void CoolScrollBar::addHighlightRegExp(const QRegularExpression& regExp, const QColor& color)
+{
+    if (regExp.pattern().isEmpty() || !regExp.isValid()) return;
+
+    CoolScrollHighlightTerm term;
+    term.regExp = regExp;
+    term.color = color.isValid() ? color : nextTermColor();
+    if (m_highlightTerms.size() >= l_maxHighlightTerms)
+    {
+        m_highlightTerms.removeFirst();
+    }
+    m_highlightTerms.push_back(term);
+    highlightTermsInDocument();
+    update();
+}
+
+void CoolScrollBar::removeHighlightTerm(const QString& text)
+{
+    auto sameText = [&text](const CoolScrollHighlightTerm& term)
+    {
+        return !term.isRegExp() &&
+            term.text.compare(text, term.wholeWord ? Qt::CaseSensitive : Qt::CaseInsensitive) == 0;
+    };
+    auto it = std::remove_if(m_highlightTerms.begin(), m_highlightTerms.end(), sameText);
+    if (it == m_highlightTerms.end()) return;
+
+    m_highlightTerms.erase(it, m_highlightTerms.end());
+    highlightTermsInDocument();
+    update();
+}
+
+void CoolScrollBar::toggleHighlightTerm(const QString& text)
+{
+    if (text.isEmpty()) return;
+
+    // double click on already pinned term unpins it
+    for (const CoolScrollHighlightTerm& term : m_highlightTerms)
+    {
+        if (!term.isRegExp() &&
+            term.text.compare(text, term.wholeWord ? Qt::CaseSensitive : Qt::CaseInsensitive) == 0)
+        {
+            removeHighlightTerm(text);
+            return;
+        }
+    }
+    // a double clicked identifier is that token, anything else a substring
+    addHighlightTerm(text, QColor(), true);
+}
+
+QColor CoolScrollBar::nextTermColor() const
+{
+    // rotate hue of the configured color and take the first one not used yet
+    const QColor base = settings().selectionHighlightColor;
+    for (int slot = 0; slot < l_maxHighlightTerms; ++slot)
+    {
+        QColor color = base;
+        if (slot > 0)
+        {
+            color.setHsv((qMax(base.hsvHue(), 0) + slot * l_termHueStep) % 360,
+                         qMax(base.hsvSaturation(), 128), base.value(), base.alpha());
+        }
+        bool used = false;
+        for (const CoolScrollHighlightTerm& term : m_highlightTerms)
+        {
+            used = used || term.color == color;
+        }
+        if (!used)
+        {
+            return color;
+        }
+    }
+    return base;
 }
 
 void CoolScrollBar::mousePressEvent(QMouseEvent *event)
 {
+    hideLens();
+
     if(event->button() == Qt::LeftButton)
     {
         setValue(posToScrollValue(event->pos().y()));
@@ -327,25 +1174,125 @@ void CoolScrollBar::mouseMoveEvent(QMouseEvent *event)
 {
     if(m_leftButtonPressed)
     {
-        setValue(posToScrollValue(event->pos().y()));
+        m_dragPos = event->pos().y();
+        ++m_dragEvents;
+        if (m_dragTimer.isActive())
+        {
+            m_dragPending = true;
+            return;
+        }
+        // first move of a frame scrolls right away, the rest waits for the timer
+        applyDragPosition();
+        m_dragTimer.start();
+    }
+    else
+    {
+        updateLens(event->pos().y());
     }
 }
 
+void CoolScrollBar::leaveEvent(QEvent *)
+{
+    hideLens();
+}
+
+void CoolScrollBar::updateLens(qreal pos)
+{
+    if (!m_renderData || !settings().showHoverLens || unfoldedLinesCount() == 0)
+    {
+        hideLens();
+        return;
+    }
+
+    if (!m_lens)
+    {
+        m_lens = new CoolScrollLens(m_metrics, this);
+    }
+    // the lens draws from the snapshot, the editor keeps its layout
+    const int row = qBound(0, firstVisibleRow() + int(pos / calculateLineHeight()), unfoldedLinesCount() - 1);
+    m_lens->setSource(m_snapshots->snapshot(), m_parentEdit->document(), m_parentEdit->font(),
+                      m_parentEdit->palette(), tabSize());
+    m_lens->showAt(wrapModel().blockAt(row), QRect(mapToGlobal(QPoint(0, int(pos))), QSize(width(), 1)));
+}
+
+void CoolScrollBar::hideLens()
+{
+    if (m_lens)
+    {
+        m_lens->hide();
+    }
+}
+
+void CoolScrollBar::dragFrameElapsed()
+{
+    if (!m_leftButtonPressed || !m_dragPending) return;
+
+    applyDragPosition();
+    m_dragTimer.start();
+}
+
+void CoolScrollBar::applyDragPosition()
+{
+    m_metrics->addSample(QStringLiteral("drag.events_per_scroll"), m_dragEvents);
+    m_dragPending = false;
+    m_dragEvents = 0;
+    setValue(dragPosToScrollValue(m_dragPos));
+}
+
 bool CoolScrollBar::hasHighlight() const
 {
-    return m_renderData && !m_renderData->selectedAreas.empty();
+    return !m_highlightTerms.isEmpty();
 }
 
 void CoolScrollBar::resizeEvent(QResizeEvent *)
 {
+    // a splitter drag resizes on every step, the precise picture and
+    // highlights are made once the size has settled
+    m_resizeTimer.start();
+}
+
+void CoolScrollBar::showEvent(QShowEvent *event)
+{
+    m_shown = true;
+    QScrollBar::showEvent(event);
+}
+
+void CoolScrollBar::resizeSettled()
+{
+    updateYScale();
+    // highlight coverage is kept per pixel row
+    if (hasHighlight())
+    {
+        highlightTermsInDocument();
+    }
+    documentCursorPositionChanged();
+    update();
+}
+
+void CoolScrollBar::windowMoved()
+{
+    if (!m_renderData) return;
+
+    const int firstRow = firstVisibleRow();
+    if (firstRow == m_renderData->areasFirstRow) return;
+
+    m_renderData->areasFirstRow = firstRow;
+    if (hasHighlight())
+    {
+        highlightTermsInDocument();
+    }
+    documentCursorPositionChanged();
 }
 
 int CoolScrollBar::posToScrollValue(qreal pos) const
 {
     if (!m_renderData) return 0;
 
-    qreal documentHeight = calculateLineHeight() * unfoldedLinesCount();//internalDocument()->lineCount() * calculateLineHeight() * getYScale();
-    int value = int(pos * (maximum() + linesInViewportCount()) / documentHeight);
+    // the clicked row is mapped back to a line of the editor layout, through
+    // the window a scrolling minimap shows
+    const int row = qBound(0, firstVisibleRow() + int(pos / calculateLineHeight()),
+                           qMax(0, unfoldedLinesCount() - 1));
+    int value = rowToValue(row);
 
     // set center of a viewport to position of click
     value -= linesInViewportCount() / 2;
@@ -360,10 +1307,34 @@ int CoolScrollBar::posToScrollValue(qreal pos) const
     return value;
 }
 
+int CoolScrollBar::dragPosToScrollValue(qreal pos) const
+{
+    if (!m_renderData) return 0;
+
+    if (m_yAdditionalScale < 1.0)
+    {
+        // the window moves with the value, so a dragged row would run away; the value
+        // is found from where in the bar the viewport is centered, the fixed point of
+        // posToScrollValue() and inverse of firstVisibleRow()
+        const qreal barRows = height() / calculateLineHeight();
+        const int viewportRows = linesInViewportCount();
+        const qreal span = qMax<qreal>(1.0, barRows - viewportRows);
+        const qreal fraction = qBound<qreal>(0.0, (pos / calculateLineHeight() - viewportRows / 2.0) / span, 1.0);
+        return minimum() + qRound(fraction * (maximum() - minimum()));
+    }
+    return posToScrollValue(pos);
+}
+
 void CoolScrollBar::mouseReleaseEvent(QMouseEvent *event)
 {
     if(event->button() == Qt::LeftButton)
     {
+        // the last position of the drag must not be lost
+        if (m_dragPending)
+        {
+            applyDragPosition();
+        }
+        m_dragTimer.stop();
         m_leftButtonPressed = false;
     }
 }
@@ -371,18 +1342,51 @@ void CoolScrollBar::mouseReleaseEvent(QMouseEvent *event)
 
 void CoolScrollBar::clearHighlight()
 {
+    m_highlightTerms.clear();
+    m_termsResolvedByIndex.clear();
+    ++m_searchGeneration;
     if (!m_renderData) return;
 
     m_renderData->selectedAreas.clear();
-    m_stringToHighlight.clear();
 }
 
 void CoolScrollBar::applySettings()
 {
+    const CoolScrollbarSettings& s = settings();
+
+    // the picture checks the generation itself, highlights follow the resize
+    if (m_appliedSettings.geometry != s.geometryGeneration)
+    {
+        m_appliedSettings.geometry = s.geometryGeneration;
+        resize(s.scrollBarWidth, height());
+        updateGeometry();
+    }
+
+    // other bars of hidden editors catch up when they are activated
     if (!m_renderData) return;
 
-    resize(settings().scrollBarWidth, height());
-    updateGeometry();
+    if (m_appliedSettings.features != s.featureGeneration)
+    {
+        m_appliedSettings.features = s.featureGeneration;
+        m_tokenIndex->setEnabled(s.tokenIndexEnabled || s.highlightWordUnderCursor);
+        if (!s.showVcsChanges)
+        {
+            ++m_diffGeneration;
+            m_changes.clear();
+        }
+        else if (!m_baselineRequested)
+        {
+            loadBaseline();
+        }
+        else
+        {
+            startDiff();
+        }
+        documentCursorPositionChanged();
+    }
+
+    // colors and scale are only used while painting
+    update();
 }
 
 
@@ -395,15 +1399,41 @@ void CoolScrollBar::activate()
     }
 
     m_renderData = new CoolScrallBarRenderData();
+    m_tokenIndex->setPriority(CoolScrollScheduler::ActiveEditor);
+    updateYScale();
 
     applySettings();
+    // edits made while hidden are not followed by the change bars
+    if (settings().showVcsChanges && m_hasBaseline)
+    {
+        startDiff();
+    }
+    highlightTermsInDocument();
     update();
 
     m_parentEdit->viewport()->installEventFilter(this);
+    // hovering shows the lens
+    setMouseTracking(true);
     connect(m_parentEdit, SIGNAL(textChanged()),      SLOT(documentContentChanged()));
     connect(m_parentEdit, SIGNAL(selectionChanged()), SLOT(documentSelectionChanged()));
+    connect(m_parentEdit, SIGNAL(cursorPositionChanged()), SLOT(documentCursorPositionChanged()));
     connect(m_parentEdit->document()->documentLayout(), &QAbstractTextDocumentLayout::documentSizeChanged,
                                                   this, &CoolScrollBar::documentSizeChanged);
+
+    connect(m_snapshots, &CoolScrollSnapshotTracker::blocksReplaced,
+                   this, &CoolScrollBar::documentBlocksReplaced);
+    connect(m_snapshots, &CoolScrollSnapshotTracker::visibilityChanged,
+                   this, &CoolScrollBar::documentVisibilityChanged);
+    // text marks (bookmarks, breakpoints, diagnostics) update the extra area
+    if (auto layout = qobject_cast<TextEditor::TextDocumentLayout*>(m_parentEdit->document()->documentLayout()))
+    {
+        connect(layout, &TextEditor::TextDocumentLayout::updateExtraArea,
+                  this, &CoolScrollBar::scheduleMarkerImport);
+    }
+
+    // edits made while hidden were not followed by the markers
+    m_markers.invalidateRows();
+    importEditorMarkers();
 }
 
 void CoolScrollBar::deactivate()
@@ -412,14 +1442,24 @@ void CoolScrollBar::deactivate()
         delete m_renderData;
 
     m_renderData = nullptr;
-
+    m_tokenIndex->setPriority(jobPriority());
+    // m_content stays, it is reused on activation if still up to date
+
+    m_markerImportTimer.stop();
+    m_diffTimer.stop();
+    m_dragTimer.stop();
+    m_leftButtonPressed = false;
+    setMouseTracking(false);
+    hideLens();
     m_parentEdit->viewport()->removeEventFilter(this);
     disconnect(m_parentEdit, 0, this, 0);
+    disconnect(m_parentEdit->document(), 0, this, 0);
     disconnect(m_parentEdit->document()->documentLayout(), 0, this, 0);
+    disconnect(m_snapshots, 0, this, 0);
 }
 
 CoolScrollBar::CoolScrallBarRenderData::CoolScrallBarRenderData()
 {
-    font.setPointSizeF(l_maxLineHeight);
+    font.setPointSizeF(CoolScrollRenderer::maxLineHeight());
     font.setStyleHint(QFont::Monospace);
 }
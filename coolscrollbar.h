@@ -31,9 +31,22 @@
 #define COOLSCROLLAREA_H
 
 #include <QScrollBar>
-#include <QtGui/QPixmap>
+#include <QtGui/QImage>
 #include <QTextCharFormat>
 #include <QTextDocument>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include <coreplugin/highlightscrollbarcontroller.h>
+
+#include "coolscrolldiff.h"
+#include "coolscrolldiskcache.h"
+#include "coolscrollmarkerlayer.h"
+#include "coolscrollmultisearch.h"
+#include "coolscrollqualitygovernor.h"
+#include "coolscrollrenderer.h"
+#include "coolscrollscheduler.h"
+#include "coolscrollwrapmodel.h"
 
 #include <experimental/optional>
 
@@ -44,6 +57,9 @@ namespace TextEditor
 }
 
 class CoolScrollbarSettings;
+class CoolScrollMetrics;
+class CoolScrollLens;
+class CoolScrollTokenIndex;
 class QTextDocument;
 
 class CoolScrollBar : public QScrollBar
@@ -51,7 +67,9 @@ class CoolScrollBar : public QScrollBar
     Q_OBJECT
 public:
     CoolScrollBar(TextEditor::TextEditorWidget* edit,
-                  QSharedPointer<CoolScrollbarSettings>& settings);
+                  QSharedPointer<CoolScrollbarSettings>& settings,
+                  QSharedPointer<CoolScrollMetrics>& metrics,
+                  QSharedPointer<CoolScrollScheduler>& scheduler);
 
     ~CoolScrollBar();
 
@@ -60,20 +78,53 @@ public:
     void activate();
     void deactivate();
 
+    // renders the picture of an inactive editor on a worker, so that its
+    // activation finds it up to date; a bar never shown is first sized from
+    // its editor; false when there is nothing to do, otherwise prewarmFinished() follows
+    bool prewarm();
+    void cancelPrewarm();
+    // memory of the picture, and what it would take when rendered now
+    qint64 contentBytes() const;
+    qint64 expectedContentBytes() const;
+    // frees the picture of an inactive editor, it is rendered when needed again
+    void releaseContent();
+
+    // pinned highlight terms, all of them are found in a single scan; whole
+    // word terms are identifiers, looked up in the token index when it is ready
+    void addHighlightTerm(const QString& text, const QColor& color = QColor(), bool wholeWord = false);
+    void addHighlightRegExp(const QRegularExpression& regExp, const QColor& color = QColor());
+    void removeHighlightTerm(const QString& text);
+    void clearHighlight();
+
+    // markers are block numbers, e.g. search results, bookmarks or diagnostics
+    void setMarkers(CoolScrollMarkerLayer::Category category, const QVector<int>& blocks);
+    void addMarkers(CoolScrollMarkerLayer::Category category, const QVector<int>& blocks);
+    void clearMarkers(CoolScrollMarkerLayer::Category category);
+
+    // changes of the document against this text are shown at the left edge
+    void setBaselineText(const QString& text);
+
+signals:
+    // the picture started by prewarm() is in place or was dropped
+    void prewarmFinished();
+
 protected:
 
     void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *);
+    void showEvent(QShowEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void contextMenuEvent(QContextMenuEvent *event);
+    void leaveEvent(QEvent *event);
 
     inline const CoolScrollbarSettings& settings() const { return *m_settings; }
 
     QSize sizeHint() const;
     QSize minimumSizeHint() const;
 
+    // rows of the minimap, wrapped lines included
     int unfoldedLinesCount() const;
     int linesInViewportCount() const;
     qreal calculateLineHeight() const;
@@ -85,13 +136,37 @@ protected:
 
     bool eventFilter(QObject *obj, QEvent *e);
 
-    void drawDocumentPreview(QPainter& p, const TextEditor::TextDocument& document);
+    void updateFont();
+    bool contentUpToDate() const;
+    // whether the picture only differs in size and may be shown scaled
+    bool canScaleContent() const;
+    void renderContent();
+    // keeps the memory metrics in step with the content image
+    void accountContentMemory();
+    bool loadCachedContent(const CoolScrollRenderParams& params);
+    void storeCachedContent(const CoolScrollRenderParams& params);
 
 protected slots:
 
     void documentContentChanged();
     void documentSelectionChanged();
     void documentSizeChanged(const QSizeF);
+    void highlightSearchFinished();
+    void documentCursorPositionChanged();
+    void tokenIndexReady();
+    void scheduleMarkerImport();
+    void importEditorMarkers();
+    void documentBlocksReplaced(int first, int removed, int added);
+    void documentStateChanged();
+    void reloadBaseline();
+    void documentVisibilityChanged(int first, int count);
+    void startDiff();
+    void diffFinished();
+    void dragFrameElapsed();
+    void diskCacheValidated();
+    void prewarmRendered();
+    void resizeSettled();
+    void windowMoved();
 
 private:
 
@@ -104,31 +179,132 @@ private:
                 delete currentDocumentCopy;
             selectedAreas.clear();
         }
-        QPixmap         contentPixmap;
-        QVector<QRectF> selectedAreas;
+        QVector<CoolScrollHighlightCoverage> selectedAreas; // one per highlight term
+        CoolScrollHighlightCoverage cursorWordAreas;
+        int             areasFirstRow = 0; // window the highlights were searched for
         QTextDocument*  currentDocumentCopy = nullptr;
         QFont           font;
+        qreal           charWidth = 1.0;
+        qreal           fontLineHeight = 0.0;
+        int             fontWidth = 0;
     };
 
+    // rendered document picture, kept while the editor is hidden
+    struct CoolScrollContentCache
+    {
+        QImage          image; // physical resolution, see devicePixelRatio()
+        bool            valid = false;
+        int             revision = -1;   // of the rendered snapshot
+        int             generation = -1; // settings geometry generation
+        int             wrapGeneration = -1;
+        qreal           lineHeight = 0.0;    // logical pixels the picture was drawn with
+        int             firstRow = 0;        // of the window a long document is drawn in
+        bool            fromDiskCache = false; // until validated in background
+        bool            diskCacheChecked = false;
+        CoolScrollDiskCacheKey storedKey;
+        qint64          accountedBytes = 0; // reported to metrics
+        qint64          accountedArgbBytes = 0;
+    };
 
-    int posToScrollValue(qreal pos) const;
+    // settings generations this bar has applied
+    struct CoolScrollAppliedSettings
+    {
+        int geometry = -1;
+        int features = -1;
+    };
 
-    void clearHighlight();
-    void highlightEntryInDocument(const QString& stringToHighlight);
+
+    int posToScrollValue(qreal pos) const;
+    // the bar position dragged to, see posToScrollValue() for clicks
+    int dragPosToScrollValue(qreal pos) const;
+
+    // the size the editor layout gave, estimated from the editor before the first show
+    QSize layoutSize() const;
+    // data need not be m_renderData, hidden editors are prewarmed without it
+    CoolScrollRenderParams renderParams(const CoolScrallBarRenderData& data) const;
+
+    // the editor being worked in goes first, then other editors on screen
+    CoolScrollScheduler::Priority jobPriority() const;
+
+    // 0 when the editor does not wrap
+    int editorWrapColumn() const;
+    int tabSize() const;
+    const CoolScrollWrapModel& wrapModel() const;
+    // scroll values are lines of the editor layout, rows come from the wrap model
+    int valueToRow(int value) const;
+    // row at the top of the bar, 0 unless the document is taller than the bar
+    int firstVisibleRow() const;
+    int rowToValue(int row) const;
+    void applyDragPosition();
+    // shows the lines under the pointer in the lens, or hides it
+    void updateLens(qreal pos);
+    void hideLens();
+
+    void toggleHighlightTerm(const QString& text);
+    void highlightTermsInDocument();
+    CoolScrollSearchInput searchGeometry() const;
+    CoolScrollHighlightCoverage tokenAreas(const QString& token) const;
+    void paintHighlight(QPainter& painter, const CoolScrollHighlightCoverage& areas,
+                        const QColor& color, int firstRow) const;
+    QColor nextTermColor() const;
 
     bool hasHighlight() const;
 
+    void loadBaseline();
+    void loadBaselineFromDisk(const QString& filePath, int generation);
+    QString decodeBaseline(const QByteArray& data) const;
+
     TextEditor::TextEditorWidget* m_parentEdit;
     const QSharedPointer<CoolScrollbarSettings> m_settings;
+    const QSharedPointer<CoolScrollMetrics> m_metrics;
+    const QSharedPointer<CoolScrollScheduler> m_scheduler;
+
+    qreal m_yAdditionalScale; // this paramter is <1.0 if file is to large, see updateYScale()
+
+    QVector<CoolScrollHighlightTerm> m_highlightTerms;
+    QVector<bool> m_termsResolvedByIndex;
+    QFutureWatcher<CoolScrollSearchResult> m_searchWatcher;
+    int m_searchGeneration;
 
-    qreal m_yAdditionalScale; // this paramter is <1.0 if file is to large
+    CoolScrollSnapshotTracker* m_snapshots;
+    CoolScrollTokenIndex* m_tokenIndex;
 
-    QString m_stringToHighlight;
+    CoolScrollMarkerLayer m_markers;
+    QTimer m_markerImportTimer; // one import per event loop turn
+    QHash<Core::Id, QVector<Core::Highlight>> m_importedHighlights;
+
+    CoolScrollChangeLayer m_changes;
+    QVector<QString> m_baselineLines;
+    bool m_hasBaseline;
+    bool m_baselineRequested;
+    int m_baselineGeneration;
+    QTimer m_diffTimer;
+    QFutureWatcher<CoolScrollDiffResult> m_diffWatcher;
+    int m_diffGeneration;
+
+    QFutureWatcher<bool> m_diskCacheWatcher;
+    QFutureWatcher<QImage> m_prewarmWatcher;
+    CoolScrollContentCache m_prewarmed; // what the picture being prewarmed is for
 
     bool m_highlightNextSelection;
     bool m_leftButtonPressed;
 
+    // drag is applied at most once per frame, the latest position wins
+    QTimer m_dragTimer;
+    qreal m_dragPos;
+    bool m_dragPending;
+    int m_dragEvents;
+
+    QTimer m_resizeTimer;
+
+    mutable CoolScrollWrapModel m_wrap; // follows the snapshot, see wrapModel()
+
     CoolScrallBarRenderData* m_renderData;
+    CoolScrollContentCache m_content;
+    CoolScrollQualityGovernor m_quality;
+    CoolScrollLens* m_lens; // made on the first hover
+    bool m_shown; // once shown, the size is the one the editor layout gave
+    CoolScrollAppliedSettings m_appliedSettings;
 
     void updateYScale();
 };
@@ -29,6 +29,8 @@
 
 #include "coolscrollbarsettings.h"
 
+#include <QStandardPaths>
+
 namespace
 {
     const QString l_nWidth(QStringLiteral("scrollbar_width"));
@@ -37,6 +39,17 @@ namespace
     const QString l_nXScale(QStringLiteral("x_default_scale"));
     const QString l_nYScale(QStringLiteral("y_default_scale"));
     const QString l_nContextMenu(QStringLiteral("disable_context_menu"));
+    const QString l_nTokenIndex(QStringLiteral("token_index_enabled"));
+    const QString l_nWordUnderCursor(QStringLiteral("highlight_word_under_cursor"));
+    const QString l_nVcsChanges(QStringLiteral("show_vcs_changes"));
+    const QString l_nHoverLens(QStringLiteral("show_hover_lens"));
+    const QString l_nScrollingMinimap(QStringLiteral("scrolling_minimap"));
+    const QString l_nDiskCache(QStringLiteral("disk_cache_enabled"));
+    const QString l_nDiskCacheDirectory(QStringLiteral("disk_cache_directory"));
+    const QString l_nFrameBudget(QStringLiteral("frame_budget_ms"));
+    const QString l_nPrewarmIdle(QStringLiteral("prewarm_idle_ms"));
+    const QString l_nMemoryBudget(QStringLiteral("memory_budget_mb"));
+    const QString l_nOutlineGap(QStringLiteral("outline_gap_columns"));
 }
 
 CoolScrollbarSettings::CoolScrollbarSettings() :
@@ -46,6 +59,20 @@ CoolScrollbarSettings::CoolScrollbarSettings() :
     xDefaultScale(0.9),
     yDefaultScale(0.7),
     disableContextMenu(true),
+    tokenIndexEnabled(false),
+    highlightWordUnderCursor(false),
+    showVcsChanges(true),
+    showHoverLens(true),
+    scrollingMinimap(false),
+    diskCacheEnabled(false),
+    diskCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                       + QStringLiteral("/coolscroll")),
+    frameBudget(16),
+    prewarmIdle(1500),
+    memoryBudget(64),
+    outlineGap(8),
+    geometryGeneration(0),
+    featureGeneration(0),
     m_minSelectionHeight(1.5)
 {
     m_textOption.setTabStop(2.0);
@@ -59,6 +86,17 @@ void CoolScrollbarSettings::save(QSettings *settings)
     settings->setValue(l_nXScale, xDefaultScale);
     settings->setValue(l_nYScale, yDefaultScale);
     settings->setValue(l_nContextMenu, disableContextMenu);
+    settings->setValue(l_nTokenIndex, tokenIndexEnabled);
+    settings->setValue(l_nWordUnderCursor, highlightWordUnderCursor);
+    settings->setValue(l_nVcsChanges, showVcsChanges);
+    settings->setValue(l_nHoverLens, showHoverLens);
+    settings->setValue(l_nScrollingMinimap, scrollingMinimap);
+    settings->setValue(l_nDiskCache, diskCacheEnabled);
+    settings->setValue(l_nDiskCacheDirectory, diskCacheDirectory);
+    settings->setValue(l_nFrameBudget, frameBudget);
+    settings->setValue(l_nPrewarmIdle, prewarmIdle);
+    settings->setValue(l_nMemoryBudget, memoryBudget);
+    settings->setValue(l_nOutlineGap, outlineGap);
 }
 
 void CoolScrollbarSettings::read(const QSettings *settings)
@@ -73,4 +111,33 @@ void CoolScrollbarSettings::read(const QSettings *settings)
     xDefaultScale = settings->value(l_nXScale, xDefaultScale).toDouble();
     yDefaultScale = settings->value(l_nYScale, yDefaultScale).toDouble();
     disableContextMenu = settings->value(l_nContextMenu, disableContextMenu).toBool();
+    tokenIndexEnabled = settings->value(l_nTokenIndex, tokenIndexEnabled).toBool();
+    highlightWordUnderCursor = settings->value(l_nWordUnderCursor, highlightWordUnderCursor).toBool();
+    showVcsChanges = settings->value(l_nVcsChanges, showVcsChanges).toBool();
+    showHoverLens = settings->value(l_nHoverLens, showHoverLens).toBool();
+    scrollingMinimap = settings->value(l_nScrollingMinimap, scrollingMinimap).toBool();
+    diskCacheEnabled = settings->value(l_nDiskCache, diskCacheEnabled).toBool();
+    diskCacheDirectory = settings->value(l_nDiskCacheDirectory, diskCacheDirectory).toString();
+    frameBudget = settings->value(l_nFrameBudget, frameBudget).toInt();
+    prewarmIdle = settings->value(l_nPrewarmIdle, prewarmIdle).toInt();
+    memoryBudget = settings->value(l_nMemoryBudget, memoryBudget).toInt();
+    outlineGap = settings->value(l_nOutlineGap, outlineGap).toInt();
+}
+
+void CoolScrollbarSettings::updateGenerations(const CoolScrollbarSettings& previous)
+{
+    if (scrollBarWidth != previous.scrollBarWidth || scrollingMinimap != previous.scrollingMinimap
+            || outlineGap != previous.outlineGap)
+    {
+        ++geometryGeneration;
+    }
+    if (tokenIndexEnabled != previous.tokenIndexEnabled
+            || highlightWordUnderCursor != previous.highlightWordUnderCursor
+            || showVcsChanges != previous.showVcsChanges
+            || diskCacheEnabled != previous.diskCacheEnabled
+            || diskCacheDirectory != previous.diskCacheDirectory
+            || frameBudget != previous.frameBudget)
+    {
+        ++featureGeneration;
+    }
 }
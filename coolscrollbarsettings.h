@@ -44,12 +44,32 @@ public:
     void save(QSettings* settings);
     void read(const QSettings* settings);
 
+    // bumps generations of aspects which differ from previous settings
+    void updateGenerations(const CoolScrollbarSettings& previous);
+
     int scrollBarWidth;
     QColor viewportColor;
     QColor selectionHighlightColor;
     qreal xDefaultScale;
     qreal yDefaultScale;
     bool disableContextMenu;
+    bool tokenIndexEnabled;
+    bool highlightWordUnderCursor;
+    bool showVcsChanges;
+    bool showHoverLens;
+    bool scrollingMinimap; // fixed line height, the picture scrolls when the document is taller
+    bool diskCacheEnabled;
+    QString diskCacheDirectory;
+    int frameBudget; // milliseconds a render may take before detail is reduced
+    int prewarmIdle; // milliseconds without input before hidden editors are rendered, 0 disables
+    int memoryBudget; // megabytes the pictures of all editors may take
+    int outlineGap; // whitespace columns splitting bars of the outline detail, 0 draws one bar per line
+
+    // increased on every change of an aspect, scroll bars compare them with
+    // generations their cached pictures and state were built for; colors and
+    // scale have none, they are only read while painting
+    int geometryGeneration; // width or line height, the document picture is rendered again
+    int featureGeneration;  // index, word highlight, VCS changes, disk cache, budget
 
     // these options cannot be changed by user
     qreal m_minSelectionHeight;
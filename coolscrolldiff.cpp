@@ -0,0 +1,383 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "coolscrolldiff.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPainter>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int l_changeBarWidth = 3;
+    // larger distance for one middle snake search marks the whole range as changed
+    const int l_maxEditCost = 4096;
+
+    const QColor l_addedColor(80, 180, 80);
+    const QColor l_modifiedColor(80, 140, 230);
+    const QColor l_deletedColor(220, 60, 60);
+
+    class MyersDiff
+    {
+    public:
+        MyersDiff(const QVector<uint>& a, const QVector<uint>& b);
+
+        void compare(int aLo, int aHi, int bLo, int bHi);
+        QVector<CoolScrollDiffHunk> hunks() const;
+
+    private:
+
+        bool middleSnake(int aLo, int aHi, int bLo, int bHi, int& splitX, int& splitY);
+        static void markChanged(QVector<bool>& changed, int from, int to);
+
+        const QVector<uint>& m_a;
+        const QVector<uint>& m_b;
+        QVector<bool> m_changedA;
+        QVector<bool> m_changedB;
+        QVector<int> m_forward;
+        QVector<int> m_backward;
+        int m_offset;
+    };
+
+    MyersDiff::MyersDiff(const QVector<uint>& a, const QVector<uint>& b) :
+        m_a(a),
+        m_b(b),
+        m_changedA(a.size(), false),
+        m_changedB(b.size(), false),
+        m_offset(2 * (a.size() + b.size()) + 2)
+    {
+        m_forward.resize(2 * m_offset + 1);
+        m_backward.resize(2 * m_offset + 1);
+    }
+
+    void MyersDiff::markChanged(QVector<bool>& changed, int from, int to)
+    {
+        for (int i = from; i < to; ++i)
+        {
+            changed[i] = true;
+        }
+    }
+
+    bool MyersDiff::middleSnake(int aLo, int aHi, int bLo, int bHi, int& splitX, int& splitY)
+    {
+        const int n = aHi - aLo;
+        const int m = bHi - bLo;
+        const int delta = n - m;
+        const bool odd = (delta & 1) != 0;
+        const int maxCost = qMin((n + m + 1) / 2, l_maxEditCost);
+
+        // both indexed by diagonal k = x - y
+        int* forward = m_forward.data() + m_offset;
+        int* backward = m_backward.data() + m_offset;
+        forward[1] = 0;
+        backward[delta + 1] = n + 1;
+
+        for (int d = 0; d <= maxCost; ++d)
+        {
+            for (int k = -d; k <= d; k += 2)
+            {
+                int x = (k == -d || (k != d && forward[k - 1] < forward[k + 1]))
+                        ? forward[k + 1] : forward[k - 1] + 1;
+                int y = x - k;
+                while (x < n && y < m && m_a[aLo + x] == m_b[bLo + y])
+                {
+                    ++x;
+                    ++y;
+                }
+                forward[k] = x;
+                if (odd && k >= delta - (d - 1) && k <= delta + (d - 1) && x >= backward[k] &&
+                    x <= n && y >= 0 && y <= m)
+                {
+                    splitX = aLo + x;
+                    splitY = bLo + y;
+                    return true;
+                }
+            }
+            for (int k = -d; k <= d; k += 2)
+            {
+                const int kb = k + delta;
+                int x = (k == -d || (k != d && backward[kb + 1] - 1 < backward[kb - 1]))
+                        ? backward[kb + 1] - 1 : backward[kb - 1];
+                int y = x - kb;
+                while (x > 0 && y > 0 && m_a[aLo + x - 1] == m_b[bLo + y - 1])
+                {
+                    --x;
+                    --y;
+                }
+                backward[kb] = x;
+                if (!odd && kb >= -d && kb <= d && x <= forward[kb] &&
+                    x >= 0 && y >= 0 && y <= m)
+                {
+                    splitX = aLo + x;
+                    splitY = bLo + y;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void MyersDiff::compare(int aLo, int aHi, int bLo, int bHi)
+    {
+        while (aLo < aHi && bLo < bHi && m_a[aLo] == m_b[bLo])
+        {
+            ++aLo;
+            ++bLo;
+        }
+        while (aLo < aHi && bLo < bHi && m_a[aHi - 1] == m_b[bHi - 1])
+        {
+            --aHi;
+            --bHi;
+        }
+
+        int x = 0;
+        int y = 0;
+        if (aLo == aHi || bLo == bHi ||
+            !middleSnake(aLo, aHi, bLo, bHi, x, y) ||
+            (x == aLo && y == bLo) || (x == aHi && y == bHi))
+        {
+            // pure insertion/deletion, too expensive or no progress possible
+            markChanged(m_changedA, aLo, aHi);
+            markChanged(m_changedB, bLo, bHi);
+            return;
+        }
+        compare(aLo, x, bLo, y);
+        compare(x, aHi, y, bHi);
+    }
+
+    QVector<CoolScrollDiffHunk> MyersDiff::hunks() const
+    {
+        QVector<CoolScrollDiffHunk> hunks;
+        int i = 0;
+        int j = 0;
+        while (i < m_a.size() || j < m_b.size())
+        {
+            if (i < m_a.size() && j < m_b.size() && !m_changedA[i] && !m_changedB[j])
+            {
+                ++i;
+                ++j;
+                continue;
+            }
+            const int start = j;
+            int oldCount = 0;
+            while (i < m_a.size() && m_changedA[i])
+            {
+                ++i;
+                ++oldCount;
+            }
+            while (j < m_b.size() && m_changedB[j])
+            {
+                ++j;
+            }
+            if (oldCount == 0 && j == start)
+            {
+                break;
+            }
+            hunks.push_back(CoolScrollDiffHunk { start, j - start, oldCount });
+        }
+        return hunks;
+    }
+
+    QVector<uint> internLines(const QVector<QString>& lines, QHash<QString, uint>& ids)
+    {
+        QVector<uint> result;
+        result.reserve(lines.size());
+        for (const QString& line : lines)
+        {
+            auto it = ids.constFind(line);
+            if (it == ids.constEnd())
+            {
+                it = ids.insert(line, uint(ids.size()));
+            }
+            result.push_back(it.value());
+        }
+        return result;
+    }
+}
+
+CoolScrollDiffResult coolScrollDiff(const QVector<QString>& baseline,
+                                    const QVector<QString>& current, int generation)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QHash<QString, uint> ids;
+    ids.reserve(baseline.size());
+    const QVector<uint> a = internLines(baseline, ids);
+    const QVector<uint> b = internLines(current, ids);
+
+    MyersDiff diff(a, b);
+    diff.compare(0, a.size(), 0, b.size());
+
+    CoolScrollDiffResult result;
+    result.generation = generation;
+    result.hunks = diff.hunks();
+    result.elapsed = timer.nsecsElapsed() / 1000;
+    return result;
+}
+
+QVector<QString> coolScrollSplitLines(const QString& text)
+{
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    QVector<QString> result;
+    result.reserve(lines.size());
+    for (const QString& line : lines)
+    {
+        result.push_back(line.endsWith(QLatin1Char('\r')) ? line.left(line.size() - 1) : line);
+    }
+    return result;
+}
+
+CoolScrollChangeLayer::CoolScrollChangeLayer() :
+    m_cacheValid(false),
+    m_cacheLineHeight(0.0),
+    m_cacheFirstRow(0),
+    m_cacheWrapGeneration(-1)
+{
+}
+
+void CoolScrollChangeLayer::setHunks(const QVector<CoolScrollDiffHunk>& hunks)
+{
+    m_hunks = hunks;
+    m_cacheValid = false;
+}
+
+void CoolScrollChangeLayer::clear()
+{
+    m_hunks.clear();
+    m_cache = QImage();
+    m_cacheValid = false;
+}
+
+void CoolScrollChangeLayer::applyEdit(int first, int lastOld, int lastNew)
+{
+    const int delta = lastNew - lastOld;
+
+    // the edited blocks and the hunks they touch become one range, lines
+    // between hunks stay aligned with the baseline; [start, end) is in
+    // lines before the edit
+    int editedStart = first;
+    int editedEnd = lastOld + 1;
+    int mergedNewCount = 0;
+    int mergedOldCount = 0;
+    bool editedAdded = false;
+
+    QVector<CoolScrollDiffHunk> hunks;
+    hunks.reserve(m_hunks.size() + 1);
+    const auto addEdited = [&]()
+    {
+        const int newCount = editedEnd + delta - editedStart;
+        const int oldCount = editedEnd - editedStart - mergedNewCount + mergedOldCount;
+        if (newCount > 0 || oldCount > 0)
+        {
+            hunks.push_back(CoolScrollDiffHunk { editedStart, newCount, oldCount });
+        }
+        editedAdded = true;
+    };
+    for (const CoolScrollDiffHunk& hunk : m_hunks)
+    {
+        const int hunkEnd = hunk.newStart + hunk.newCount;
+        if (hunk.newStart < first && hunkEnd <= first)
+        {
+            hunks.push_back(hunk);
+        }
+        else if (hunk.newStart > lastOld)
+        {
+            if (!editedAdded)
+            {
+                addEdited();
+            }
+            hunks.push_back(CoolScrollDiffHunk { hunk.newStart + delta, hunk.newCount, hunk.oldCount });
+        }
+        else
+        {
+            editedStart = qMin(editedStart, hunk.newStart);
+            editedEnd = qMax(editedEnd, hunkEnd);
+            mergedNewCount += hunk.newCount;
+            mergedOldCount += hunk.oldCount;
+        }
+    }
+    if (!editedAdded)
+    {
+        addEdited();
+    }
+    m_hunks = hunks;
+    m_cacheValid = false;
+}
+
+void CoolScrollChangeLayer::paint(QPainter& p, const CoolScrollWrapModel& wrap,
+                                  qreal lineHeight, int firstRow, const QSize& size)
+{
+    if (m_hunks.isEmpty()) return;
+
+    if (!m_cacheValid || m_cache.height() != size.height() || m_cacheLineHeight != lineHeight
+            || m_cacheFirstRow != firstRow || m_cacheWrapGeneration != wrap.generation())
+    {
+        renderCache(wrap, lineHeight, firstRow, size);
+    }
+    p.drawImage(0, 0, m_cache);
+}
+
+void CoolScrollChangeLayer::renderCache(const CoolScrollWrapModel& wrap, qreal lineHeight, int firstRow,
+                                        const QSize& size)
+{
+    m_cache = QImage(l_changeBarWidth, qMax(1, size.height()), QImage::Format_ARGB32_Premultiplied);
+    m_cache.fill(Qt::transparent);
+
+    // hunks are sorted, the ones ending above the window are skipped
+    const int firstBlock = wrap.blockAt(firstRow);
+    const int lastRow = firstRow + int(std::ceil(size.height() / qMax(lineHeight, 0.01)));
+    auto hunk = std::lower_bound(m_hunks.constBegin(), m_hunks.constEnd(), firstBlock,
+                                 [](const CoolScrollDiffHunk& h, int block) { return h.newStart + h.newCount < block; });
+
+    QPainter p(&m_cache);
+    for (; hunk != m_hunks.constEnd() && wrap.firstRow(hunk->newStart) <= lastRow; ++hunk)
+    {
+        // blocks past the end start at the last row
+        const qreal top = lineHeight * (wrap.firstRow(hunk->newStart) - firstRow);
+
+        if (hunk->type() == CoolScrollDiffHunk::Deleted)
+        {
+            p.fillRect(QRectF(0, top - 1.0, l_changeBarWidth, 2.0), l_deletedColor);
+            continue;
+        }
+
+        const qreal bottom = lineHeight * (wrap.firstRow(hunk->newStart + hunk->newCount) - firstRow);
+        p.fillRect(QRectF(0, top, l_changeBarWidth, qMax(1.0, bottom - top)),
+                   hunk->type() == CoolScrollDiffHunk::Added ? l_addedColor : l_modifiedColor);
+    }
+    m_cacheLineHeight = lineHeight;
+    m_cacheFirstRow = firstRow;
+    m_cacheWrapGeneration = wrap.generation();
+    m_cacheValid = true;
+}
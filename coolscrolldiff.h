@@ -0,0 +1,104 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef COOLSCROLLDIFF_H
+#define COOLSCROLLDIFF_H
+
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+#include "coolscrollwrapmodel.h"
+
+class QPainter;
+
+// lines [newStart, newStart + newCount) of the current text replace
+// oldCount lines of the baseline
+struct CoolScrollDiffHunk
+{
+    enum Type { Added, Modified, Deleted };
+
+    int newStart;
+    int newCount;
+    int oldCount;
+
+    inline Type type() const
+    {
+        return oldCount == 0 ? Added : (newCount == 0 ? Deleted : Modified);
+    }
+};
+
+struct CoolScrollDiffResult
+{
+    int generation = 0;
+    QVector<CoolScrollDiffHunk> hunks;
+    qint64 elapsed = 0; // microseconds
+};
+
+// line diff (Myers, linear space), safe to call from a worker thread
+CoolScrollDiffResult coolScrollDiff(const QVector<QString>& baseline,
+                                    const QVector<QString>& current, int generation);
+
+QVector<QString> coolScrollSplitLines(const QString& text);
+
+// change bars painted at the left edge, cached as an image
+// which is redrawn only when hunks or geometry change
+class CoolScrollChangeLayer
+{
+public:
+    CoolScrollChangeLayer();
+
+    void setHunks(const QVector<CoolScrollDiffHunk>& hunks);
+    void clear();
+    inline bool isEmpty() const { return m_hunks.isEmpty(); }
+    inline const QVector<CoolScrollDiffHunk>& hunks() const { return m_hunks; }
+
+    // keeps bars in place until next diff arrives: blocks [first, lastOld]
+    // were replaced by [first, lastNew]; no hunks means the text was the
+    // baseline, so only call it while there is one
+    void applyEdit(int first, int lastOld, int lastNew);
+
+    inline void invalidate() { m_cacheValid = false; }
+
+    // firstRow is the row at the top of the bar, the window of a scrolling minimap
+    void paint(QPainter& p, const CoolScrollWrapModel& wrap, qreal lineHeight, int firstRow, const QSize& size);
+
+private:
+
+    void renderCache(const CoolScrollWrapModel& wrap, qreal lineHeight, int firstRow, const QSize& size);
+
+    QVector<CoolScrollDiffHunk> m_hunks;
+    QImage m_cache;
+    bool m_cacheValid;
+    qreal m_cacheLineHeight;
+    int m_cacheFirstRow;
+    int m_cacheWrapGeneration;
+};
+
+#endif // COOLSCROLLDIFF_H
@@ -0,0 +1,255 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrolldiskcache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtDebug>
+
+#include <algorithm>
+
+namespace
+{
+    const quint32 l_magic = 0x434d5343; // "CSMC"
+    // bump when the renderer or the layout below changes
+    const quint32 l_version = 3;
+    // entries stored least recently are removed above this size
+    const qint64 l_maxDirectoryBytes = 256 * 1024 * 1024;
+
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        qint64 fileSize;
+        qint64 fileModified;
+        quint64 contentHash;
+        double devicePixelRatio;
+        double lineHeight;
+        qint32 logicalWidth;
+        qint32 logicalHeight;
+        qint32 width;
+        qint32 height;
+        qint32 bytesPerLine;
+        qint32 format;
+        qint32 colorCount; // palette entries written after the header
+        qint32 firstRow;
+        qint32 quality;
+        qint32 tabSize;
+        qint32 outlineGap;
+        qint32 wrapColumn;
+        quint32 background;
+        quint32 foreground;
+        qint32 reserved;
+    };
+    static_assert(sizeof(Header) % 16 == 0, "pixel data must stay aligned after the header");
+
+    // palette padded to keep pixel data aligned
+    inline qint64 paletteBytes(int colorCount)
+    {
+        return (qint64(colorCount) * sizeof(QRgb) + 15) / 16 * 16;
+    }
+
+    const quint64 l_fnvOffset = 14695981039346656037ULL;
+    const quint64 l_fnvPrime = 1099511628211ULL;
+
+    void unmapEntry(void* file)
+    {
+        // closing the file unmaps its memory
+        delete static_cast<QFile*>(file);
+    }
+}
+
+CoolScrollDiskCache::CoolScrollDiskCache(const QString& directory) :
+    m_directory(directory)
+{
+}
+
+CoolScrollDiskCacheKey CoolScrollDiskCache::key(const QString& filePath, const CoolScrollRenderParams& params,
+                                                int wrapColumn)
+{
+    CoolScrollDiskCacheKey result;
+    const QFileInfo info(filePath);
+    if (filePath.isEmpty() || !info.isFile()) return result;
+
+    result.filePath = info.absoluteFilePath();
+    result.fileSize = info.size();
+    result.fileModified = info.lastModified().toMSecsSinceEpoch();
+    result.size = params.size;
+    result.devicePixelRatio = params.devicePixelRatio;
+    result.lineHeight = params.lineHeight;
+    result.firstRow = params.firstRow;
+    result.quality = params.quality;
+    result.tabSize = params.tabSize;
+    result.outlineGap = params.outlineGap;
+    result.wrapColumn = wrapColumn;
+    result.background = params.background.rgba();
+    result.foreground = params.foreground.rgba();
+    return result;
+}
+
+QImage CoolScrollDiskCache::load(const CoolScrollDiskCacheKey& key, quint64* contentHash) const
+{
+    if (!key.isValid()) return QImage();
+
+    QFile* file = new QFile(entryPath(key.filePath));
+    if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(Header)))
+    {
+        delete file;
+        return QImage();
+    }
+
+    // a private mapping is writable, so setting the palette and the pixel ratio
+    // below does not make the image copy its pixels out of the mapping
+    uchar* data = file->map(0, file->size(), QFileDevice::MapPrivateOption);
+    const Header* header = reinterpret_cast<const Header*>(data);
+    // the pixel checks keep a truncated or foreign entry from becoming a bogus image
+    const QSize physicalSize = key.size * key.devicePixelRatio;
+    const bool hit = data && header->magic == l_magic && header->version == l_version
+            && header->fileSize == key.fileSize && header->fileModified == key.fileModified
+            && header->devicePixelRatio == key.devicePixelRatio && header->lineHeight == key.lineHeight
+            && header->logicalWidth == key.size.width() && header->logicalHeight == key.size.height()
+            && header->firstRow == key.firstRow && header->quality == key.quality
+            && header->tabSize == key.tabSize && header->outlineGap == key.outlineGap
+            && header->wrapColumn == key.wrapColumn
+            && header->background == key.background && header->foreground == key.foreground
+            && header->format == QImage::Format_Indexed8
+            && header->width == physicalSize.width() && header->height == physicalSize.height()
+            && header->bytesPerLine >= header->width
+            && header->colorCount >= 0 && header->colorCount <= 256
+            && file->size() >= qint64(sizeof(Header)) + paletteBytes(header->colorCount)
+                               + qint64(header->bytesPerLine) * header->height;
+    if (!hit)
+    {
+        delete file;
+        return QImage();
+    }
+
+    *contentHash = header->contentHash;
+    // pixels stay in the mapping, the file is closed when the last copy of the image goes away
+    const QRgb* colors = reinterpret_cast<const QRgb*>(data + sizeof(Header));
+    QImage image(data + sizeof(Header) + paletteBytes(header->colorCount), header->width, header->height,
+                 header->bytesPerLine, QImage::Format(header->format), unmapEntry, file);
+    QVector<QRgb> colorTable(header->colorCount);
+    std::copy(colors, colors + header->colorCount, colorTable.begin());
+    image.setColorTable(colorTable);
+    image.setDevicePixelRatio(header->devicePixelRatio);
+    return image;
+}
+
+bool CoolScrollDiskCache::store(const CoolScrollDiskCacheKey& key, quint64 contentHash,
+                                const QImage& image) const
+{
+    if (!key.isValid() || image.isNull()) return false;
+
+    if (!QDir().mkpath(m_directory))
+    {
+        qDebug() << "cannot create minimap cache directory " << m_directory;
+        return false;
+    }
+
+    Header header = Header();
+    header.magic = l_magic;
+    header.version = l_version;
+    header.fileSize = key.fileSize;
+    header.fileModified = key.fileModified;
+    header.contentHash = contentHash;
+    header.devicePixelRatio = key.devicePixelRatio;
+    header.lineHeight = key.lineHeight;
+    header.logicalWidth = key.size.width();
+    header.logicalHeight = key.size.height();
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = image.format();
+    header.colorCount = image.colorCount();
+    header.firstRow = key.firstRow;
+    header.quality = key.quality;
+    header.tabSize = key.tabSize;
+    header.outlineGap = key.outlineGap;
+    header.wrapColumn = key.wrapColumn;
+    header.background = key.background;
+    header.foreground = key.foreground;
+
+    // written aside and renamed, a reader never maps a half written entry
+    QSaveFile file(entryPath(key.filePath));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    QVector<QRgb> colors = image.colorTable();
+    colors.resize(int(paletteBytes(header.colorCount) / sizeof(QRgb)));
+    file.write(reinterpret_cast<const char*>(colors.constData()), paletteBytes(header.colorCount));
+    file.write(reinterpret_cast<const char*>(image.constBits()), qint64(image.bytesPerLine()) * image.height());
+    if (!file.commit()) return false;
+
+    prune();
+    return true;
+}
+
+quint64 CoolScrollDiskCache::contentHash(const QVector<QString>& lines)
+{
+    // FNV-1a over UTF-16 code units, lines separated by a value no text contains
+    quint64 hash = l_fnvOffset;
+    for (const QString& line : lines)
+    {
+        const ushort* data = line.utf16();
+        for (int i = 0; i < line.size(); ++i)
+        {
+            hash = (hash ^ data[i]) * l_fnvPrime;
+        }
+        hash = (hash ^ 0xffffu) * l_fnvPrime;
+    }
+    return hash;
+}
+
+void CoolScrollDiskCache::prune() const
+{
+    // the newest entries are kept, entries still mapped elsewhere may fail to go
+    const QFileInfoList entries = QDir(m_directory).entryInfoList(QStringList(QStringLiteral("*.minimap")),
+                                                                  QDir::Files, QDir::Time);
+    qint64 bytes = 0;
+    for (const QFileInfo& entry : entries)
+    {
+        bytes += entry.size();
+        if (bytes > l_maxDirectoryBytes)
+        {
+            QFile::remove(entry.absoluteFilePath());
+        }
+    }
+}
+
+QString CoolScrollDiskCache::entryPath(const QString& filePath) const
+{
+    const QByteArray name = QCryptographicHash::hash(filePath.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(name) + QStringLiteral(".minimap");
+}
@@ -0,0 +1,104 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLDISKCACHE_H
+#define COOLSCROLLDISKCACHE_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "coolscrollrenderer.h"
+
+// identifies a rendered minimap: the file it shows and how it was rendered
+struct CoolScrollDiskCacheKey
+{
+    QString filePath;
+    qint64 fileSize = 0;
+    qint64 fileModified = 0; // msecs since epoch
+    QSize size;              // logical pixels
+    qreal devicePixelRatio = 1.0;
+    qreal lineHeight = 1.0;
+    int firstRow = 0;
+    int quality = 0;         // CoolScrollRenderer::Detail
+    int tabSize = 4;
+    int outlineGap = 8;
+    int wrapColumn = 0;
+    QRgb background = 0;
+    QRgb foreground = 0;
+
+    bool isValid() const { return !filePath.isEmpty(); }
+
+    bool operator==(const CoolScrollDiskCacheKey& other) const
+    {
+        return filePath == other.filePath && fileSize == other.fileSize
+                && fileModified == other.fileModified && size == other.size
+                && devicePixelRatio == other.devicePixelRatio && lineHeight == other.lineHeight
+                && firstRow == other.firstRow && quality == other.quality && tabSize == other.tabSize
+                && outlineGap == other.outlineGap && wrapColumn == other.wrapColumn
+                && background == other.background && foreground == other.foreground;
+    }
+};
+
+// Minimap images stored one file per document in a binary format which is
+// mapped into memory on load, so a cached image is shown without copying
+// or decoding it. The content hash saved next to the image is checked
+// against the document by the caller, file size and time only preselect;
+// everything else the picture is drawn with must match. The least recently
+// stored entries are removed when the directory grows past its limit.
+class CoolScrollDiskCache
+{
+public:
+    explicit CoolScrollDiskCache(const QString& directory);
+
+    inline const QString& directory() const { return m_directory; }
+
+    // key of the file on disk as it is now drawn with params, invalid for documents without a file
+    static CoolScrollDiskCacheKey key(const QString& filePath, const CoolScrollRenderParams& params,
+                                      int wrapColumn);
+
+    // returns a null image on a miss, the image refers to mapped file memory
+    QImage load(const CoolScrollDiskCacheKey& key, quint64* contentHash) const;
+    // safe to call from a worker thread
+    bool store(const CoolScrollDiskCacheKey& key, quint64 contentHash, const QImage& image) const;
+
+    // hash of the drawn lines, cheap enough for a worker to recompute on load
+    static quint64 contentHash(const QVector<QString>& lines);
+
+private:
+
+    QString entryPath(const QString& filePath) const;
+    void prune() const;
+
+    QString m_directory;
+};
+
+#endif // COOLSCROLLDISKCACHE_H
@@ -0,0 +1,333 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrolldocumentsnapshot.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include <algorithm>
+
+namespace
+{
+    // blocks per chunk, an edit copies at most a few chunks of this size
+    // and the chunk list itself is this many times shorter than the document
+    const int l_chunkBlocks = 256;
+}
+
+CoolScrollDocumentSnapshot::CoolScrollDocumentSnapshot() :
+    m_blockCount(0),
+    m_revision(0)
+{
+}
+
+int CoolScrollDocumentSnapshot::chunkOf(int block) const
+{
+    Q_ASSERT(block >= 0 && block < m_blockCount);
+    const auto it = std::upper_bound(m_chunkStarts.constBegin(), m_chunkStarts.constEnd(), block);
+    return int(it - m_chunkStarts.constBegin()) - 1;
+}
+
+const QString& CoolScrollDocumentSnapshot::text(int block) const
+{
+    const int chunk = chunkOf(block);
+    return m_chunks[chunk]->at(block - m_chunkStarts[chunk]).text;
+}
+
+bool CoolScrollDocumentSnapshot::isVisible(int block) const
+{
+    const int chunk = chunkOf(block);
+    return m_chunks[chunk]->at(block - m_chunkStarts[chunk]).visible;
+}
+
+CoolScrollTextColumns::Kind CoolScrollDocumentSnapshot::kind(int block) const
+{
+    const int chunk = chunkOf(block);
+    return m_chunks[chunk]->at(block - m_chunkStarts[chunk]).kind;
+}
+
+const CoolScrollOutline& CoolScrollDocumentSnapshot::outline(int block) const
+{
+    const int chunk = chunkOf(block);
+    return m_chunks[chunk]->at(block - m_chunkStarts[chunk]).outline;
+}
+
+QVector<QString> CoolScrollDocumentSnapshot::texts() const
+{
+    QVector<QString> result;
+    result.reserve(m_blockCount);
+    for (const QSharedPointer<const Chunk>& chunk : m_chunks)
+    {
+        for (const Block& block : *chunk)
+        {
+            result.push_back(block.text);
+        }
+    }
+    return result;
+}
+
+QVector<QString> CoolScrollDocumentSnapshot::visibleTexts(int maxCount) const
+{
+    QVector<QString> result;
+    result.reserve(qMin(maxCount, m_blockCount));
+    for (const QSharedPointer<const Chunk>& chunk : m_chunks)
+    {
+        for (const Block& block : *chunk)
+        {
+            if (result.size() == maxCount)
+            {
+                return result;
+            }
+            if (block.visible)
+            {
+                result.push_back(block.text);
+            }
+        }
+    }
+    return result;
+}
+
+void CoolScrollDocumentSnapshot::updateChunkStarts(int fromChunk)
+{
+    m_chunkStarts.resize(m_chunks.size());
+    int start = fromChunk > 0 ? m_chunkStarts[fromChunk - 1] + m_chunks[fromChunk - 1]->size() : 0;
+    for (int i = fromChunk; i < m_chunks.size(); ++i)
+    {
+        m_chunkStarts[i] = start;
+        start += m_chunks[i]->size();
+    }
+    m_blockCount = start;
+}
+
+CoolScrollSnapshotTracker::CoolScrollSnapshotTracker(QTextDocument* document, QObject* parent) :
+    QObject(parent),
+    m_document(document),
+    m_visibilityDirty(false),
+    m_inEdit(false)
+{
+    reset();
+    connect(m_document, &QTextDocument::contentsChange,
+                  this, &CoolScrollSnapshotTracker::documentContentsChange);
+    connect(m_document, &QTextDocument::contentsChanged,
+                  this, &CoolScrollSnapshotTracker::documentContentsChanged);
+    connect(m_document->documentLayout(), &QAbstractTextDocumentLayout::documentSizeChanged,
+                                    this, &CoolScrollSnapshotTracker::documentLayoutChanged);
+}
+
+CoolScrollDocumentSnapshot CoolScrollSnapshotTracker::snapshot()
+{
+    if (m_visibilityDirty)
+    {
+        refreshVisibility();
+    }
+    return m_current;
+}
+
+void CoolScrollSnapshotTracker::documentContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+
+    // the layout reports its new size before the edit ends
+    m_inEdit = true;
+
+    QTextBlock firstBlock = m_document->findBlock(position);
+    QTextBlock lastBlock = m_document->findBlock(position + charsAdded);
+    if (!firstBlock.isValid()) firstBlock = m_document->lastBlock();
+    if (!lastBlock.isValid()) lastBlock = m_document->lastBlock();
+
+    const int first = firstBlock.blockNumber();
+    const int lastNew = lastBlock.blockNumber();
+    const int lastOld = lastNew - (m_document->blockCount() - m_current.blockCount());
+    if (lastOld < first - 1 || lastOld >= m_current.blockCount())
+    {
+        // should not happen, start over rather than keep a broken copy
+        const int removed = m_current.blockCount();
+        reset();
+        emit blocksReplaced(0, removed, m_current.blockCount());
+        return;
+    }
+
+    CoolScrollDocumentSnapshot::Chunk blocks;
+    blocks.reserve(lastNew - first + 1);
+    for (QTextBlock block = firstBlock; block.isValid() && block.blockNumber() <= lastNew; block = block.next())
+    {
+        blocks.push_back(CoolScrollDocumentSnapshot::Block { block.text(), block.isVisible(),
+                                                             CoolScrollTextColumns::Ascii });
+    }
+
+    const int removed = lastOld - first + 1;
+    if (removed == blocks.size())
+    {
+        // format changes are reported as edits too, they do not make a new revision
+        bool same = true;
+        for (int i = 0; i < removed && same; ++i)
+        {
+            same = m_current.text(first + i) == blocks[i].text;
+        }
+        if (same) return;
+    }
+
+    for (CoolScrollDocumentSnapshot::Block& block : blocks)
+    {
+        block.kind = CoolScrollTextColumns::classify(block.text);
+        block.outline = CoolScrollOutline::scan(block.text);
+    }
+    replaceBlocks(first, removed, blocks);
+    emit blocksReplaced(first, removed, blocks.size());
+}
+
+void CoolScrollSnapshotTracker::documentContentsChanged()
+{
+    m_inEdit = false;
+}
+
+void CoolScrollSnapshotTracker::documentLayoutChanged()
+{
+    // the size changes with almost every edit, the edited blocks were read
+    // with their visibility already; only folding changes it without text
+    if (m_inEdit) return;
+
+    m_visibilityDirty = true;
+}
+
+void CoolScrollSnapshotTracker::reset()
+{
+    CoolScrollDocumentSnapshot::Chunk blocks;
+    blocks.reserve(m_document->blockCount());
+    for (QTextBlock block = m_document->firstBlock(); block.isValid(); block = block.next())
+    {
+        const QString text = block.text();
+        blocks.push_back(CoolScrollDocumentSnapshot::Block { text, block.isVisible(),
+                                                             CoolScrollTextColumns::classify(text),
+                                                             CoolScrollOutline::scan(text) });
+    }
+    const int revision = m_current.revision();
+    m_current = CoolScrollDocumentSnapshot();
+    m_current.m_revision = revision;
+    replaceBlocks(0, 0, blocks);
+    m_visibilityDirty = false;
+}
+
+void CoolScrollSnapshotTracker::replaceBlocks(int first, int removed,
+                                              const CoolScrollDocumentSnapshot::Chunk& blocks)
+{
+    CoolScrollDocumentSnapshot& s = m_current;
+
+    // chunks [firstChunk, lastChunk] are touched by the edit, the rest is shared
+    int firstChunk = s.m_chunks.size();
+    int lastChunk = firstChunk - 1;
+    if (s.m_blockCount > 0)
+    {
+        firstChunk = s.chunkOf(qMin(first, s.m_blockCount - 1));
+        lastChunk = removed > 0 ? s.chunkOf(first + removed - 1) : firstChunk;
+    }
+
+    CoolScrollDocumentSnapshot::Chunk merged;
+    if (firstChunk <= lastChunk)
+    {
+        const CoolScrollDocumentSnapshot::Chunk& head = *s.m_chunks[firstChunk];
+        const CoolScrollDocumentSnapshot::Chunk& tail = *s.m_chunks[lastChunk];
+        const int headCount = first - s.m_chunkStarts[firstChunk];
+        const int tailStart = first + removed - s.m_chunkStarts[lastChunk];
+        merged.reserve(headCount + blocks.size() + tail.size() - tailStart);
+        merged += head.mid(0, headCount);
+        merged += blocks;
+        merged += tail.mid(tailStart);
+    }
+    else
+    {
+        merged = blocks;
+    }
+
+    // cut into chunks of similar size
+    const int pieces = qMax(1, (merged.size() + l_chunkBlocks - 1) / l_chunkBlocks);
+    QVector<QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>> chunks;
+    chunks.reserve(pieces);
+    for (int i = 0; i < pieces; ++i)
+    {
+        const int begin = int(qint64(merged.size()) * i / pieces);
+        const int end = int(qint64(merged.size()) * (i + 1) / pieces);
+        if (end > begin)
+        {
+            chunks.push_back(QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>(
+                                 new CoolScrollDocumentSnapshot::Chunk(merged.mid(begin, end - begin))));
+        }
+    }
+
+    const int keepFrom = qMin(firstChunk, s.m_chunks.size());
+    const int replaced = lastChunk - firstChunk + 1;
+    s.m_chunks.remove(keepFrom, qMax(0, replaced));
+    for (int i = 0; i < chunks.size(); ++i)
+    {
+        s.m_chunks.insert(keepFrom + i, chunks[i]);
+    }
+    s.updateChunkStarts(keepFrom);
+    ++s.m_revision;
+}
+
+void CoolScrollSnapshotTracker::refreshVisibility()
+{
+    m_visibilityDirty = false;
+    CoolScrollDocumentSnapshot& s = m_current;
+    Q_ASSERT(s.m_blockCount == m_document->blockCount());
+
+    // range of blocks whose visibility changed
+    int first = -1;
+    int last = -1;
+    QTextBlock block = m_document->firstBlock();
+    for (int chunkIndex = 0; chunkIndex < s.m_chunks.size(); ++chunkIndex)
+    {
+        QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>& chunk = s.m_chunks[chunkIndex];
+        // copied only when some of its blocks were folded or unfolded
+        CoolScrollDocumentSnapshot::Chunk* copy = nullptr;
+        for (int i = 0; i < chunk->size() && block.isValid(); ++i, block = block.next())
+        {
+            if (chunk->at(i).visible == block.isVisible()) continue;
+
+            if (!copy)
+            {
+                copy = new CoolScrollDocumentSnapshot::Chunk(*chunk);
+            }
+            (*copy)[i].visible = block.isVisible();
+            last = s.m_chunkStarts[chunkIndex] + i;
+            first = first < 0 ? last : first;
+        }
+        if (copy)
+        {
+            chunk = QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>(copy);
+        }
+    }
+    if (first >= 0)
+    {
+        ++s.m_revision;
+        emit visibilityChanged(first, last - first + 1);
+    }
+}
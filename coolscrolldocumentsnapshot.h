@@ -0,0 +1,173 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLDOCUMENTSNAPSHOT_H
+#define COOLSCROLLDOCUMENTSNAPSHOT_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include <limits>
+
+#include "coolscrolloutline.h"
+#include "coolscrolltextcolumns.h"
+
+class QTextDocument;
+
+// Immutable copy of document text which worker threads may keep while the
+// document is edited. Blocks are stored in chunks shared between revisions,
+// so an edit copies only the chunks it touches.
+class CoolScrollDocumentSnapshot
+{
+public:
+    CoolScrollDocumentSnapshot();
+
+    // grows with every change of text or folding, used to detect stale results
+    inline int revision() const { return m_revision; }
+    inline int blockCount() const { return m_blockCount; }
+
+    const QString& text(int block) const;
+    bool isVisible(int block) const;
+    // classified once when the block text changes
+    CoolScrollTextColumns::Kind kind(int block) const;
+    // scanned once when the block text changes as well
+    const CoolScrollOutline& outline(int block) const;
+
+    QVector<QString> texts() const;
+    // texts of blocks which are not folded, one per drawn line
+    QVector<QString> visibleTexts(int maxCount = std::numeric_limits<int>::max()) const;
+
+    // calls f(text, visible, kind) for blocks in order from the first one
+    // until it returns false, nothing is copied
+    template <typename Function>
+    void forEachBlock(Function f, int first = 0) const;
+    // the same with f(text, visible, kind, outline)
+    template <typename Function>
+    void forEachOutline(Function f, int first = 0) const;
+
+private:
+
+    friend class CoolScrollSnapshotTracker;
+    friend class CoolScrollWrapModel;
+
+    struct Block
+    {
+        QString text;
+        bool visible;
+        CoolScrollTextColumns::Kind kind;
+        CoolScrollOutline outline;
+    };
+    typedef QVector<Block> Chunk;
+
+    template <typename Function>
+    void forEachEntry(Function f, int first) const;
+
+    int chunkOf(int block) const;
+    void updateChunkStarts(int fromChunk);
+
+    QVector<QSharedPointer<const Chunk>> m_chunks;
+    QVector<int> m_chunkStarts; // number of the first block of each chunk
+    int m_blockCount;
+    int m_revision;
+};
+
+template <typename Function>
+void CoolScrollDocumentSnapshot::forEachBlock(Function f, int first) const
+{
+    forEachEntry([&f](const Block& block) { return f(block.text, block.visible, block.kind); }, first);
+}
+
+template <typename Function>
+void CoolScrollDocumentSnapshot::forEachOutline(Function f, int first) const
+{
+    forEachEntry([&f](const Block& block) { return f(block.text, block.visible, block.kind, block.outline); },
+                 first);
+}
+
+template <typename Function>
+void CoolScrollDocumentSnapshot::forEachEntry(Function f, int first) const
+{
+    if (first >= m_blockCount) return;
+
+    // chunks before the first block are skipped without looking at them
+    const int firstChunk = first > 0 ? chunkOf(first) : 0;
+    int i = first > 0 ? first - m_chunkStarts[firstChunk] : 0;
+    for (int chunk = firstChunk; chunk < m_chunks.size(); ++chunk, i = 0)
+    {
+        const Chunk& blocks = *m_chunks[chunk];
+        for (; i < blocks.size(); ++i)
+        {
+            if (!f(blocks[i])) return;
+        }
+    }
+}
+
+// Follows edits of a document on the GUI thread and hands out snapshots of it.
+class CoolScrollSnapshotTracker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CoolScrollSnapshotTracker(QTextDocument* document, QObject* parent = nullptr);
+
+    // cheap, only folding changes since the last call are looked up here
+    CoolScrollDocumentSnapshot snapshot();
+    inline int revision() const { return m_current.revision(); }
+
+signals:
+
+    // blocks [first, first + removed) were replaced by [first, first + added),
+    // not emitted when the text of blocks stays the same (e.g. rehighlighting)
+    void blocksReplaced(int first, int removed, int added);
+    // blocks in [first, first + count) were folded or unfolded, emitted when
+    // a snapshot is taken after the change; nested blocks which kept their
+    // visibility may lie in between
+    void visibilityChanged(int first, int count);
+
+private slots:
+
+    void documentContentsChange(int position, int charsRemoved, int charsAdded);
+    void documentContentsChanged();
+    void documentLayoutChanged();
+
+private:
+
+    void reset();
+    void replaceBlocks(int first, int removed, const CoolScrollDocumentSnapshot::Chunk& blocks);
+    void refreshVisibility();
+
+    QTextDocument* m_document;
+    CoolScrollDocumentSnapshot m_current;
+    bool m_visibilityDirty;
+    bool m_inEdit; // between contentsChange and contentsChanged of one edit
+};
+
+#endif // COOLSCROLLDOCUMENTSNAPSHOT_H
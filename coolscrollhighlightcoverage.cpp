@@ -0,0 +1,116 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "coolscrollhighlightcoverage.h"
+
+#include <QPainter>
+
+#include <cmath>
+
+namespace
+{
+    const quint16 l_maxCount = 0xffff;
+
+    // rows with most matches are drawn this much darker, in percents
+    const int l_maxDarkening = 80;
+
+    inline quint16 toPixel(qreal x)
+    {
+        return quint16(qBound(0.0, x, qreal(l_maxCount)));
+    }
+}
+
+CoolScrollHighlightCoverage::CoolScrollHighlightCoverage(int height, int firstRow) :
+    m_rows(height, Row { 0, 0, 0 }),
+    m_firstRow(firstRow),
+    m_matches(0),
+    m_maxCount(0)
+{
+}
+
+void CoolScrollHighlightCoverage::add(const QRectF& area)
+{
+    const int top = qMax(0, int(std::floor(area.top())));
+    const int bottom = qMin(m_rows.size(), int(std::ceil(area.bottom())));
+    const quint16 left = toPixel(std::floor(area.left()));
+    const quint16 right = toPixel(std::ceil(area.right()));
+
+    for (int y = top; y < bottom; ++y)
+    {
+        Row& row = m_rows[y];
+        if (row.count == 0)
+        {
+            row.left = left;
+            row.right = right;
+        }
+        else
+        {
+            row.left = qMin(row.left, left);
+            row.right = qMax(row.right, right);
+        }
+        if (row.count < l_maxCount)
+        {
+            ++row.count;
+        }
+        m_maxCount = qMax(m_maxCount, row.count);
+    }
+    ++m_matches;
+}
+
+void CoolScrollHighlightCoverage::paint(QPainter& p, const QColor& color) const
+{
+    if (isEmpty()) return;
+
+    const qreal logMax = std::log(qreal(qMax<quint16>(m_maxCount, 2)));
+
+    // adjacent rows with equal span and count are filled at once
+    int y = 0;
+    while (y < m_rows.size())
+    {
+        const Row& row = m_rows[y];
+        int end = y + 1;
+        while (end < m_rows.size() && m_rows[end].count == row.count &&
+               m_rows[end].left == row.left && m_rows[end].right == row.right)
+        {
+            ++end;
+        }
+
+        if (row.count > 0 && row.right > row.left)
+        {
+            QColor rowColor = color;
+            if (row.count > 1)
+            {
+                const qreal density = std::log(qreal(row.count)) / logMax;
+                rowColor = color.darker(100 + int(l_maxDarkening * density));
+            }
+            p.fillRect(row.left, y, row.right - row.left, end - y, rowColor);
+        }
+        y = end;
+    }
+}
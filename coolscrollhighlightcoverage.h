@@ -0,0 +1,72 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef COOLSCROLLHIGHLIGHTCOVERAGE_H
+#define COOLSCROLLHIGHLIGHTCOVERAGE_H
+
+#include <QColor>
+#include <QRectF>
+#include <QVector>
+
+class QPainter;
+
+// Highlight matches reduced to pixel rows of the scroll bar. Each row keeps
+// the horizontal span and the number of matches covering it, so memory and
+// paint time depend on the bar height, not on the number of matches.
+// Pixel row 0 shows the first row of the window the matches were placed in.
+class CoolScrollHighlightCoverage
+{
+public:
+    explicit CoolScrollHighlightCoverage(int height = 0, int firstRow = 0);
+
+    void add(const QRectF& area);
+
+    inline bool isEmpty() const { return m_matches == 0; }
+    inline int matchesCount() const { return m_matches; }
+    inline int firstRow() const { return m_firstRow; }
+
+    // rows shared by several matches are drawn denser
+    void paint(QPainter& p, const QColor& color) const;
+
+private:
+
+    struct Row
+    {
+        quint16 left;
+        quint16 right;
+        quint16 count;
+    };
+
+    QVector<Row> m_rows;
+    int m_firstRow;
+    int m_matches;
+    quint16 m_maxCount;
+};
+
+#endif // COOLSCROLLHIGHLIGHTCOVERAGE_H
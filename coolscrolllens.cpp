@@ -0,0 +1,272 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrolllens.h"
+
+#include "coolscrollmetrics.h"
+#include "coolscrolltextcolumns.h"
+
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QElapsedTimer>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextLayout>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // lines shown at once, the hovered one in the middle
+    const int l_lensLines = 21;
+    // regions start at multiples of this many blocks, a region holds this many
+    // lines more than shown, so moving within one needs no drawing
+    const int l_regionStep = 16;
+    const int l_cachedRegions = 8;
+    // columns drawn, the rest of a long line is clipped
+    const int l_lensColumns = 100;
+    const int l_margin = 4;
+}
+
+CoolScrollLens::CoolScrollLens(const QSharedPointer<CoolScrollMetrics>& metrics, QWidget* parent) :
+    QWidget(parent, Qt::ToolTip | Qt::FramelessWindowHint),
+    m_metrics(metrics),
+    m_document(nullptr),
+    m_tabSize(8),
+    m_lineHeight(1),
+    m_charWidth(1.0),
+    m_ascent(0.0),
+    m_devicePixelRatio(1.0),
+    m_topLine(0),
+    m_hoveredLine(0)
+{
+    setAttribute(Qt::WA_ShowWithoutActivating);
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+void CoolScrollLens::setSource(const CoolScrollDocumentSnapshot& snapshot, const QTextDocument* document,
+                               const QFont& font, const QPalette& palette, int tabSize)
+{
+    const qreal dpr = devicePixelRatioF();
+    if (m_document == document && m_snapshot.revision() == snapshot.revision() && m_font == font
+            && m_palette.color(QPalette::Base) == palette.color(QPalette::Base)
+            && m_palette.color(QPalette::Text) == palette.color(QPalette::Text)
+            && m_tabSize == tabSize && m_devicePixelRatio == dpr)
+    {
+        return;
+    }
+
+    m_snapshot = snapshot;
+    m_document = document;
+    m_palette = palette;
+    m_tabSize = tabSize;
+    m_devicePixelRatio = dpr;
+    m_regions.clear();
+
+    m_font = font;
+    m_boldFont = font;
+    m_boldFont.setBold(true);
+    m_italicFont = font;
+    m_italicFont.setItalic(true);
+
+    // whole pixels per line, so lines of a region image never blur
+    const QFontMetricsF metrics(m_font);
+    m_lineHeight = qMax(1, int(std::ceil(metrics.lineSpacing())));
+    m_charWidth = metrics.width(QLatin1Char(' '));
+    m_ascent = metrics.ascent();
+    resize(int(std::ceil(l_lensColumns * m_charWidth)) + 2 * l_margin, l_lensLines * m_lineHeight);
+}
+
+void CoolScrollLens::showAt(int block, const QRect& anchor)
+{
+    if (block < 0 || block >= m_snapshot.blockCount())
+    {
+        hide();
+        return;
+    }
+
+    const Region& shown = region(block);
+    const int lines = shown.blocks.size();
+    m_hoveredLine = int(std::lower_bound(shown.blocks.begin(), shown.blocks.end(), block) - shown.blocks.begin());
+    m_topLine = qBound(0, m_hoveredLine - l_lensLines / 2, qMax(0, lines - l_lensLines));
+
+    // left of the bar, centered on the pointer, kept on the screen
+    const QRect screen = QApplication::desktop()->availableGeometry(anchor.center());
+    QPoint pos(anchor.left() - width(), anchor.center().y() - height() / 2);
+    pos.setY(qBound(screen.top(), pos.y(), screen.bottom() - height()));
+    pos.setX(qMax(screen.left(), pos.x()));
+    move(pos);
+    show();
+    update();
+}
+
+const CoolScrollLens::Region& CoolScrollLens::region(int block)
+{
+    const int first = qMax(0, block / l_regionStep * l_regionStep - l_lensLines / 2);
+    for (int i = 0; i < m_regions.size(); ++i)
+    {
+        if (m_regions[i].first == first)
+        {
+            m_regions.move(i, 0);
+            m_metrics->addSample(QStringLiteral("lens.cache.hit"), 1);
+            return m_regions.first();
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    m_regions.prepend(renderRegion(first));
+    if (m_regions.size() > l_cachedRegions)
+    {
+        m_regions.removeLast();
+    }
+    m_metrics->addSample(QStringLiteral("lens.cache.miss"), 1);
+    m_metrics->addSample(QStringLiteral("lens.render.usec"), timer.nsecsElapsed() / 1000);
+    return m_regions.first();
+}
+
+CoolScrollLens::Region CoolScrollLens::renderRegion(int first) const
+{
+    Region region;
+    region.first = first;
+    const int maxLines = l_lensLines + l_regionStep;
+    for (int block = first; block < m_snapshot.blockCount() && region.blocks.size() < maxLines; ++block)
+    {
+        if (m_snapshot.isVisible(block))
+        {
+            region.blocks.push_back(block);
+        }
+    }
+
+    const QSize size(width(), qMax(1, region.blocks.size()) * m_lineHeight);
+    region.image = QImage(size * m_devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    region.image.setDevicePixelRatio(m_devicePixelRatio);
+    region.image.fill(m_palette.color(QPalette::Base));
+
+    QPainter p(&region.image);
+    p.setClipRect(QRect(l_margin, 0, size.width() - 2 * l_margin, size.height()));
+    QVector<int> starts;
+    for (int line = 0; line < region.blocks.size(); ++line)
+    {
+        drawLine(p, region.blocks[line], line * m_lineHeight, starts);
+    }
+    return region;
+}
+
+void CoolScrollLens::drawLine(QPainter& p, int block, qreal y, QVector<int>& starts) const
+{
+    const QString& text = m_snapshot.text(block);
+    const CoolScrollTextColumns::Kind kind = m_snapshot.kind(block);
+    const int end = CoolScrollTextColumns::indexAt(text, l_lensColumns, kind, m_tabSize);
+    if (end == 0) return;
+
+    // the highlighter's formats of every drawn character, later ranges win
+    QVector<int> formatOf(end, -1);
+    QVector<QTextLayout::FormatRange> formats;
+    const QTextBlock textBlock = m_document ? m_document->findBlockByNumber(block) : QTextBlock();
+    if (textBlock.isValid() && textBlock.layout())
+    {
+        formats = textBlock.layout()->formats();
+    }
+    for (int i = 0; i < formats.size(); ++i)
+    {
+        const int from = qBound(0, formats[i].start, end);
+        const int to = qBound(0, formats[i].start + formats[i].length, end);
+        std::fill(formatOf.begin() + from, formatOf.begin() + to, i);
+    }
+
+    CoolScrollTextColumns::columnStarts(text, kind, m_tabSize, starts);
+    auto x = [&starts](int index) { return starts.isEmpty() ? index : starts[index]; };
+
+    // runs of one format, tabs are skipped as they only move the next run
+    const qreal baseline = y + m_ascent;
+    int start = 0;
+    while (start < end)
+    {
+        if (text[start] == QLatin1Char('\t'))
+        {
+            ++start;
+            continue;
+        }
+        int stop = start + 1;
+        while (stop < end && formatOf[stop] == formatOf[start] && text[stop] != QLatin1Char('\t'))
+        {
+            ++stop;
+        }
+
+        QColor color = m_palette.color(QPalette::Text);
+        const QFont* font = &m_font;
+        if (formatOf[start] >= 0)
+        {
+            const QTextCharFormat& format = formats[formatOf[start]].format;
+            if (format.hasProperty(QTextFormat::ForegroundBrush))
+            {
+                color = format.foreground().color();
+            }
+            if (format.fontWeight() > QFont::Normal)
+            {
+                font = &m_boldFont;
+            }
+            else if (format.fontItalic())
+            {
+                font = &m_italicFont;
+            }
+        }
+        p.setFont(*font);
+        p.setPen(color);
+        p.drawText(QPointF(l_margin + x(start) * m_charWidth, baseline), text.mid(start, stop - start));
+        start = stop;
+    }
+}
+
+void CoolScrollLens::paintEvent(QPaintEvent*)
+{
+    QPainter p(this);
+    p.fillRect(rect(), m_palette.color(QPalette::Base));
+    if (m_regions.isEmpty()) return;
+
+    const Region& shown = m_regions.first();
+    const qreal dpr = shown.image.devicePixelRatio();
+    const int lines = qMin(l_lensLines, shown.blocks.size() - m_topLine);
+    const QRectF target(0, 0, width(), lines * m_lineHeight);
+    p.drawImage(target, shown.image, QRectF(0, m_topLine * m_lineHeight * dpr,
+                                            shown.image.width(), target.height() * dpr));
+
+    // the hovered line is marked like the current line of an editor
+    QColor marker = m_palette.color(QPalette::Highlight);
+    marker.setAlpha(60);
+    p.fillRect(QRect(0, (m_hoveredLine - m_topLine) * m_lineHeight, width(), m_lineHeight), marker);
+
+    p.setPen(m_palette.color(QPalette::Mid));
+    p.drawRect(rect().adjusted(0, 0, -1, -1));
+}
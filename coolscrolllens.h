@@ -0,0 +1,102 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLLENS_H
+#define COOLSCROLLLENS_H
+
+#include <QFont>
+#include <QImage>
+#include <QList>
+#include <QPalette>
+#include <QSharedPointer>
+#include <QVector>
+#include <QWidget>
+
+#include "coolscrolldocumentsnapshot.h"
+
+class CoolScrollMetrics;
+class QTextDocument;
+
+// Readable excerpt of the document shown next to the scroll bar while the
+// pointer hovers it. Lines come from the snapshot, colors from the formats
+// the syntax highlighter keeps on the blocks; the editor lays out nothing.
+// Excerpts are drawn per region of lines and cached, so moving the pointer
+// within a region only moves the visible part of a ready image.
+class CoolScrollLens : public QWidget
+{
+    Q_OBJECT
+public:
+    CoolScrollLens(const QSharedPointer<CoolScrollMetrics>& metrics, QWidget* parent);
+
+    // cached regions are dropped when any of these differs from the last call
+    void setSource(const CoolScrollDocumentSnapshot& snapshot, const QTextDocument* document,
+                   const QFont& font, const QPalette& palette, int tabSize);
+    // centers the excerpt on the block, left of the anchor given in global coordinates
+    void showAt(int block, const QRect& anchor);
+
+protected:
+
+    void paintEvent(QPaintEvent* event);
+
+private:
+
+    struct Region
+    {
+        int first = 0;       // block the region is cached for
+        QVector<int> blocks; // drawn block of each line, folded ones are skipped
+        QImage image;
+    };
+
+    const Region& region(int block);
+    Region renderRegion(int first) const;
+    void drawLine(QPainter& p, int block, qreal y, QVector<int>& starts) const;
+
+    const QSharedPointer<CoolScrollMetrics> m_metrics;
+
+    CoolScrollDocumentSnapshot m_snapshot;
+    const QTextDocument* m_document;
+    QFont m_font;
+    QFont m_boldFont;
+    QFont m_italicFont;
+    QPalette m_palette;
+    int m_tabSize;
+    int m_lineHeight;
+    qreal m_charWidth;
+    qreal m_ascent;
+    qreal m_devicePixelRatio;
+
+    QList<Region> m_regions; // the most recently used first
+
+    // what paintEvent() shows of the first region
+    int m_topLine;
+    int m_hoveredLine;
+};
+
+#endif // COOLSCROLLLENS_H
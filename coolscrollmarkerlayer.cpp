@@ -0,0 +1,278 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "coolscrollmarkerlayer.h"
+
+#include <QPainter>
+#include <QtMath>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    const int l_markerWidth = 4;
+    const int l_minMarkerHeight = 2;
+
+    const QColor l_markerColors[CoolScrollMarkerLayer::CategoryCount] =
+    {
+        QColor(240, 200, 0),  // FindResult
+        QColor(60, 120, 255), // Bookmark
+        QColor(150, 20, 20),  // Breakpoint
+        QColor(255, 128, 0),  // Warning
+        QColor(255, 0, 0)     // Error
+    };
+
+    int topCategory(const int* counts)
+    {
+        for (int category = CoolScrollMarkerLayer::CategoryCount - 1; category >= 0; --category)
+        {
+            if (counts[category] > 0)
+            {
+                return category;
+            }
+        }
+        return -1;
+    }
+}
+
+CoolScrollMarkerLayer::CoolScrollMarkerLayer() :
+    m_rowsValid(false),
+    m_rowsLineHeight(0.0),
+    m_rowsFirstRow(0),
+    m_rowsWrapColumn(-1),
+    m_rowsTabSize(-1),
+    m_rowsWrapGeneration(-1),
+    m_dirtyFirst(std::numeric_limits<int>::max()),
+    m_dirtyLast(-1)
+{
+}
+
+void CoolScrollMarkerLayer::setMarkers(Category category, const QVector<int>& blocks)
+{
+    QVector<int>& markers = m_markers[category];
+    markers = blocks;
+    std::sort(markers.begin(), markers.end());
+    markers.erase(std::unique(markers.begin(), markers.end()), markers.end());
+    m_rowsValid = false;
+}
+
+void CoolScrollMarkerLayer::addMarkers(Category category, const QVector<int>& blocks)
+{
+    if (blocks.isEmpty()) return;
+
+    QVector<int> merged = m_markers[category];
+    merged += blocks;
+    setMarkers(category, merged);
+}
+
+void CoolScrollMarkerLayer::clearMarkers(Category category)
+{
+    m_markers[category].clear();
+    m_rowsValid = false;
+}
+
+void CoolScrollMarkerLayer::clear()
+{
+    for (QVector<int>& markers : m_markers)
+    {
+        markers.clear();
+    }
+    m_rowsValid = false;
+}
+
+bool CoolScrollMarkerLayer::isEmpty() const
+{
+    return std::all_of(std::begin(m_markers), std::end(m_markers),
+                       [](const QVector<int>& markers) { return markers.isEmpty(); });
+}
+
+int CoolScrollMarkerLayer::markersCount(Category category) const
+{
+    return m_markers[category].size();
+}
+
+void CoolScrollMarkerLayer::blocksReplaced(int first, int removed, int added)
+{
+    const int delta = added - removed;
+    if (delta != 0)
+    {
+        // markers after the edit are renumbered, their rows are checked when painting
+        for (int category = 0; category < CategoryCount; ++category)
+        {
+            QVector<int>& markers = m_markers[category];
+            QVector<int>& rows = m_markerRows[category];
+            const bool bucketed = m_rowsValid && rows.size() == markers.size();
+            int kept = int(std::lower_bound(markers.begin(), markers.end(), first) - markers.begin());
+            for (int i = kept; i < markers.size(); ++i)
+            {
+                const int block = markers[i];
+                if (block >= first + added && block < first + removed)
+                {
+                    if (bucketed)
+                    {
+                        bucket(category, rows[i], -1);
+                    }
+                    continue;
+                }
+                markers[kept] = block >= first + removed ? block + delta : block;
+                if (bucketed)
+                {
+                    rows[kept] = rows[i];
+                }
+                ++kept;
+            }
+            markers.resize(kept);
+            if (bucketed)
+            {
+                rows.resize(kept);
+            }
+        }
+    }
+
+    if (m_dirtyLast >= first)
+    {
+        m_dirtyLast = qMax(first, m_dirtyLast + delta);
+    }
+    markDirty(first, first + qMax(added, 1) - 1);
+}
+
+void CoolScrollMarkerLayer::visibilityChanged(int first, int count)
+{
+    markDirty(first, first + qMax(count, 1) - 1);
+}
+
+void CoolScrollMarkerLayer::markDirty(int first, int last)
+{
+    m_dirtyFirst = qMin(m_dirtyFirst, first);
+    m_dirtyLast = qMax(m_dirtyLast, last);
+}
+
+void CoolScrollMarkerLayer::bucket(int category, int row, int count)
+{
+    if (row < 0) return;
+
+    const int height = m_rows.size() / CategoryCount;
+    const int top = qFloor(m_rowsLineHeight * (row - m_rowsFirstRow));
+    const int bottom = qMin(height, top + qMax(l_minMarkerHeight, int(m_rowsLineHeight)));
+    for (int pixel = qMax(0, top); pixel < bottom; ++pixel)
+    {
+        m_rows[pixel * CategoryCount + category] += count;
+    }
+}
+
+void CoolScrollMarkerLayer::bucketRows(const CoolScrollWrapModel& wrap, qreal lineHeight, int firstRow,
+                                       int height)
+{
+    m_rows.fill(0, height * CategoryCount);
+    m_rowsLineHeight = lineHeight;
+    m_rowsFirstRow = firstRow;
+    for (int category = 0; category < CategoryCount; ++category)
+    {
+        const QVector<int>& markers = m_markers[category];
+        QVector<int>& rows = m_markerRows[category];
+        rows.resize(markers.size());
+        for (int i = 0; i < markers.size(); ++i)
+        {
+            // folded or past the end when it has no rows
+            rows[i] = wrap.rows(markers[i]) > 0 ? wrap.firstRow(markers[i]) : -1;
+            bucket(category, rows[i], 1);
+        }
+    }
+    m_rowsWrapColumn = wrap.wrapColumn();
+    m_rowsTabSize = wrap.tabSize();
+    m_rowsWrapGeneration = wrap.generation();
+    m_dirtyFirst = std::numeric_limits<int>::max();
+    m_dirtyLast = -1;
+    m_rowsValid = true;
+}
+
+void CoolScrollMarkerLayer::rebucketDirty(const CoolScrollWrapModel& wrap)
+{
+    for (int category = 0; category < CategoryCount; ++category)
+    {
+        const QVector<int>& markers = m_markers[category];
+        QVector<int>& rows = m_markerRows[category];
+        int i = int(std::lower_bound(markers.begin(), markers.end(), m_dirtyFirst) - markers.begin());
+        for (; i < markers.size(); ++i)
+        {
+            const int row = wrap.rows(markers[i]) > 0 ? wrap.firstRow(markers[i]) : -1;
+            if (row == rows[i])
+            {
+                // past the dirty blocks all rows moved by the same amount
+                if (row >= 0 && markers[i] > m_dirtyLast) break;
+                continue;
+            }
+            bucket(category, rows[i], -1);
+            bucket(category, row, 1);
+            rows[i] = row;
+        }
+    }
+    m_rowsWrapGeneration = wrap.generation();
+    m_dirtyFirst = std::numeric_limits<int>::max();
+    m_dirtyLast = -1;
+}
+
+void CoolScrollMarkerLayer::paint(QPainter& p, const CoolScrollWrapModel& wrap,
+                                  qreal lineHeight, int firstRow, const QRect& rect)
+{
+    if (isEmpty()) return;
+
+    if (!m_rowsValid || m_rows.size() != rect.height() * CategoryCount || m_rowsLineHeight != lineHeight
+            || m_rowsFirstRow != firstRow || m_rowsWrapColumn != wrap.wrapColumn()
+            || m_rowsTabSize != wrap.tabSize())
+    {
+        bucketRows(wrap, lineHeight, firstRow, rect.height());
+    }
+    else if (m_dirtyLast >= 0 || m_rowsWrapGeneration != wrap.generation())
+    {
+        rebucketDirty(wrap);
+    }
+
+    // merge adjacent rows of the same category into one rect
+    const int left = rect.right() - l_markerWidth + 1;
+    const int height = m_rows.size() / CategoryCount;
+    int runStart = 0;
+    int runCategory = -1;
+    for (int row = 0; row <= height; ++row)
+    {
+        const int category = row < height ? topCategory(m_rows.constData() + row * CategoryCount) : -1;
+        if (category == runCategory)
+        {
+            continue;
+        }
+        if (runCategory >= 0)
+        {
+            p.fillRect(left, rect.top() + runStart, l_markerWidth, row - runStart,
+                       l_markerColors[runCategory]);
+        }
+        runStart = row;
+        runCategory = category;
+    }
+}
@@ -0,0 +1,102 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef COOLSCROLLMARKERLAYER_H
+#define COOLSCROLLMARKERLAYER_H
+
+#include <QVector>
+#include <QRect>
+
+#include "coolscrollwrapmodel.h"
+
+class QPainter;
+
+// Categorized markers painted at the right edge of the scroll bar.
+// Positions are bucketed into pixel rows, so painting costs O(rows)
+// no matter how many markers there are. Edits and folding only rebucket
+// the markers whose rows moved.
+class CoolScrollMarkerLayer
+{
+public:
+    // in order of increasing priority, the highest one wins a shared row
+    enum Category
+    {
+        FindResult,
+        Bookmark,
+        Breakpoint,
+        Warning,
+        Error,
+        CategoryCount
+    };
+
+    CoolScrollMarkerLayer();
+
+    // positions are block numbers
+    void setMarkers(Category category, const QVector<int>& blocks);
+    void addMarkers(Category category, const QVector<int>& blocks);
+    void clearMarkers(Category category);
+    void clear();
+
+    bool isEmpty() const;
+    int markersCount(Category category) const;
+
+    // markers follow edits, the ones in removed blocks are dropped
+    void blocksReplaced(int first, int removed, int added);
+    void visibilityChanged(int first, int count);
+    // call when rows of blocks change for another reason
+    inline void invalidateRows() { m_rowsValid = false; }
+
+    // firstRow is the row at the top of the bar, the window of a scrolling minimap
+    void paint(QPainter& p, const CoolScrollWrapModel& wrap, qreal lineHeight, int firstRow, const QRect& rect);
+
+private:
+
+    void bucketRows(const CoolScrollWrapModel& wrap, qreal lineHeight, int firstRow, int height);
+    void rebucketDirty(const CoolScrollWrapModel& wrap);
+    void markDirty(int first, int last);
+    // adds count to the pixel rows of a marker at the given row
+    void bucket(int category, int row, int count);
+
+    QVector<int> m_markers[CategoryCount]; // sorted and unique
+    QVector<int> m_markerRows[CategoryCount]; // bucketed row of each marker, -1 when folded
+
+    QVector<int> m_rows; // markers per category and pixel row, row * CategoryCount + category
+    bool m_rowsValid;
+    qreal m_rowsLineHeight;
+    int m_rowsFirstRow;
+    int m_rowsWrapColumn;
+    int m_rowsTabSize;
+    int m_rowsWrapGeneration;
+    // blocks whose rows may have changed since bucketing, rows of the blocks
+    // after them moved by the same amount
+    int m_dirtyFirst;
+    int m_dirtyLast;
+};
+
+#endif // COOLSCROLLMARKERLAYER_H
@@ -0,0 +1,88 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "coolscrollmetrics.h"
+
+#include <QMutexLocker>
+#include <QStringList>
+
+void CoolScrollMetrics::addSample(const QString& name, qint64 value)
+{
+    QMutexLocker locker(&m_mutex);
+    Sample& sample = m_samples[name];
+    if (sample.count == 0)
+    {
+        sample.min = value;
+        sample.max = value;
+    }
+    else
+    {
+        sample.min = qMin(sample.min, value);
+        sample.max = qMax(sample.max, value);
+    }
+    ++sample.count;
+    sample.total += value;
+    sample.last = value;
+}
+
+void CoolScrollMetrics::setValue(const QString& name, qint64 value)
+{
+    QMutexLocker locker(&m_mutex);
+    m_values[name] = value;
+}
+
+void CoolScrollMetrics::addValue(const QString& name, qint64 delta)
+{
+    QMutexLocker locker(&m_mutex);
+    m_values[name] += delta;
+}
+
+qint64 CoolScrollMetrics::value(const QString& name) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_values.value(name);
+}
+
+QString CoolScrollMetrics::report() const
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList lines;
+    for (auto it = m_samples.constBegin(); it != m_samples.constEnd(); ++it)
+    {
+        const Sample& s = it.value();
+        lines << QString("%1: count %2, last %3, avg %4, min %5, max %6, total %7")
+                 .arg(it.key()).arg(s.count).arg(s.last)
+                 .arg(s.total / s.count).arg(s.min).arg(s.max).arg(s.total);
+    }
+    for (auto it = m_values.constBegin(); it != m_values.constEnd(); ++it)
+    {
+        lines << QString("%1: %2").arg(it.key()).arg(it.value());
+    }
+    return lines.join('\n');
+}
@@ -0,0 +1,69 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef COOLSCROLLMETRICS_H
+#define COOLSCROLLMETRICS_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+// Timings and counters collected by scroll bars and their workers.
+// Shared by all editors, may be updated from any thread.
+class CoolScrollMetrics
+{
+public:
+    // accumulates one measurement, e.g. duration in microseconds
+    void addSample(const QString& name, qint64 value);
+    // overwrites a current value, e.g. memory in use
+    void setValue(const QString& name, qint64 value);
+    // changes a current value which several editors contribute to
+    void addValue(const QString& name, qint64 delta);
+
+    qint64 value(const QString& name) const;
+
+    QString report() const;
+
+private:
+
+    struct Sample
+    {
+        qint64 count = 0;
+        qint64 total = 0;
+        qint64 min = 0;
+        qint64 max = 0;
+        qint64 last = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QMap<QString, Sample> m_samples;
+    QMap<QString, qint64> m_values;
+};
+
+#endif // COOLSCROLLMETRICS_H
@@ -0,0 +1,307 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "coolscrollmultisearch.h"
+#include "coolscrolltokenindex.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+
+CoolScrollMultiSearch::CoolScrollMultiSearch(Qt::CaseSensitivity cs) :
+    m_caseSensitivity(cs)
+{
+    m_nodes.push_back(Node());
+    std::fill(m_rootAscii, m_rootAscii + 128, 0);
+}
+
+ushort CoolScrollMultiSearch::normalize(ushort c) const
+{
+    if (m_caseSensitivity == Qt::CaseSensitive)
+    {
+        return c;
+    }
+    if (c < 0x80)
+    {
+        return (c >= 'A' && c <= 'Z') ? ushort(c + ('a' - 'A')) : c;
+    }
+    return QChar(c).toCaseFolded().unicode();
+}
+
+int CoolScrollMultiSearch::addTerm(const QString& term)
+{
+    const int termIndex = m_termLengths.size();
+    m_termLengths.push_back(term.size());
+    if (term.isEmpty())
+    {
+        return termIndex;
+    }
+
+    int node = 0;
+    for (const QChar ch : term)
+    {
+        const ushort c = normalize(ch.unicode());
+        int next = findEdge(node, c);
+        if (next < 0)
+        {
+            next = m_nodes.size();
+            m_nodes.push_back(Node());
+
+            QVector<Edge>& edges = m_nodes[node].edges;
+            auto pos = std::lower_bound(edges.begin(), edges.end(), c,
+                                        [](const Edge& e, ushort s) { return e.symbol < s; });
+            edges.insert(pos, Edge { c, next });
+        }
+        node = next;
+    }
+    // keep the first term if two of them are equal after case folding
+    if (m_nodes[node].term < 0)
+    {
+        m_nodes[node].term = termIndex;
+    }
+    return termIndex;
+}
+
+void CoolScrollMultiSearch::build()
+{
+    QVector<int> queue;
+    queue.reserve(m_nodes.size());
+
+    for (const Edge& e : m_nodes[0].edges)
+    {
+        m_nodes[e.target].fail = 0;
+        queue.push_back(e.target);
+        if (e.symbol < 128)
+        {
+            m_rootAscii[e.symbol] = e.target;
+        }
+    }
+
+    // breadth-first, so fail links always point to already processed nodes
+    for (int head = 0; head < queue.size(); ++head)
+    {
+        const int node = queue[head];
+        const QVector<Edge> edges = m_nodes[node].edges;
+        for (const Edge& e : edges)
+        {
+            const int fail = step(m_nodes[node].fail, e.symbol);
+            Node& child = m_nodes[e.target];
+            child.fail = fail;
+            child.outputLink = m_nodes[fail].term >= 0 ? fail : m_nodes[fail].outputLink;
+            queue.push_back(e.target);
+        }
+    }
+}
+
+int CoolScrollMultiSearch::findEdge(int node, ushort c) const
+{
+    const QVector<Edge>& edges = m_nodes[node].edges;
+    auto pos = std::lower_bound(edges.constBegin(), edges.constEnd(), c,
+                                [](const Edge& e, ushort s) { return e.symbol < s; });
+    if (pos != edges.constEnd() && pos->symbol == c)
+    {
+        return pos->target;
+    }
+    return -1;
+}
+
+int CoolScrollMultiSearch::step(int state, ushort c) const
+{
+    while (state != 0)
+    {
+        const int next = findEdge(state, c);
+        if (next >= 0)
+        {
+            return next;
+        }
+        state = m_nodes[state].fail;
+    }
+    if (c < 128)
+    {
+        return m_rootAscii[c];
+    }
+    const int next = findEdge(0, c);
+    return next >= 0 ? next : 0;
+}
+
+void CoolScrollMultiSearch::search(const QString& text, int block,
+                                   QVector<CoolScrollSearchMatch>& matches) const
+{
+    if (m_nodes.size() == 1)
+    {
+        return;
+    }
+
+    const ushort* data = text.utf16();
+    const int size = text.size();
+    int state = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        state = step(state, normalize(data[i]));
+
+        int node = m_nodes[state].term >= 0 ? state : m_nodes[state].outputLink;
+        while (node >= 0)
+        {
+            const int term = m_nodes[node].term;
+            const int length = m_termLengths[term];
+            matches.push_back(CoolScrollSearchMatch { block, i - length + 1, length, term });
+            node = m_nodes[node].outputLink;
+        }
+    }
+}
+
+QRectF coolScrollMatchRect(const CoolScrollSearchInput& input, const QString& text,
+                           const CoolScrollSearchMatch& match)
+{
+    // plain arithmetic for ASCII blocks, a walk over the prefix for the rest
+    const CoolScrollTextColumns::Kind kind = input.snapshot.kind(match.block);
+    const int tabSize = input.wrap.tabSize();
+    const int first = CoolScrollTextColumns::columnOf(text, match.column, kind, tabSize);
+    const int last = CoolScrollTextColumns::columnOf(text, match.column + match.length, kind, tabSize);
+
+    // a wrapped block is drawn as several rows, the match is placed on the one it starts in
+    const int row = input.wrap.rowOfColumn(match.block, first);
+    const int column = first - (row - input.wrap.firstRow(match.block)) * input.wrap.wrapColumn();
+
+    const int visibleColumns = qMax(1, input.visibleColumns);
+    const qreal width = qMin(last - first, visibleColumns) * input.charWidth;
+    // matches past the visible columns stay pinned to the right edge
+    qreal left = input.scrollBarWidth - width;
+    if (column < visibleColumns)
+    {
+        left = column * input.charWidth;
+    }
+    if (left >= input.scrollBarWidth)
+    {
+        left = input.scrollBarWidth - width;
+    }
+    // apply minimum selection height for good visibility in large files
+    const qreal height = qMax(input.lineHeight, input.minSelectionHeight);
+    return QRectF(left, input.lineHeight * (row - input.firstRow), width, height);
+}
+
+CoolScrollSearchResult coolScrollSearch(const CoolScrollSearchInput& input)
+{
+    CoolScrollSearchResult result;
+    result.generation = input.generation;
+    result.revision = input.snapshot.revision();
+    result.areas.fill(CoolScrollHighlightCoverage(input.height, input.firstRow), input.terms.size());
+
+    // automaton term index -> input term indexes; terms equal after case
+    // folding share one automaton term, whole word ones check case and
+    // identifier boundaries on each match, so every pinned term is found
+    // in the same single scan
+    QVector<QVector<int>> automatonTerms;
+    QHash<QString, int> foldedTerms;
+    QVector<int> regExpTerms;
+    CoolScrollMultiSearch automaton(Qt::CaseInsensitive);
+    for (int i = 0; i < input.terms.size(); ++i)
+    {
+        if (input.terms[i].isRegExp())
+        {
+            if (input.terms[i].regExp.isValid())
+            {
+                regExpTerms.push_back(i);
+            }
+        }
+        else if (input.terms[i].text.isEmpty())
+        {
+            continue; // resolved elsewhere, e.g. by the token index
+        }
+        else
+        {
+            const QString folded = input.terms[i].text.toCaseFolded();
+            auto it = foldedTerms.constFind(folded);
+            if (it == foldedTerms.constEnd())
+            {
+                it = foldedTerms.insert(folded, automaton.addTerm(input.terms[i].text));
+                automatonTerms.push_back(QVector<int>());
+            }
+            automatonTerms[it.value()].push_back(i);
+        }
+    }
+    automaton.build();
+
+    // only blocks drawn in the window are searched
+    const int lastRow = input.firstRow + int(std::ceil(input.height / qMax(input.lineHeight, 0.01)));
+    const int lastBlock = input.wrap.blockAt(lastRow);
+    int next = input.wrap.blockAt(input.firstRow);
+    QVector<CoolScrollSearchMatch> automatonMatches;
+    QVector<CoolScrollSearchMatch> matches;
+    input.snapshot.forEachBlock([&](const QString& text, bool, CoolScrollTextColumns::Kind)
+    {
+        const int block = next++;
+        if (block > lastBlock) return false;
+        if (input.wrap.rows(block) == 0) return true; // folded
+
+        automatonMatches.clear();
+        matches.clear();
+
+        automaton.search(text, block, automatonMatches);
+        for (const CoolScrollSearchMatch& match : qAsConst(automatonMatches))
+        {
+            const int end = match.column + match.length;
+            // a whole word is the token itself, not a part of a longer identifier
+            const bool word = (match.column == 0
+                               || !CoolScrollTokenTable::isIdentifierPart(text.at(match.column - 1).unicode()))
+                    && (end == text.size() || !CoolScrollTokenTable::isIdentifierPart(text.at(end).unicode()));
+            for (int term : automatonTerms[match.term])
+            {
+                const CoolScrollHighlightTerm& highlightTerm = input.terms[term];
+                if (!highlightTerm.wholeWord
+                        || (word && text.midRef(match.column, match.length) == highlightTerm.text))
+                {
+                    matches.push_back(CoolScrollSearchMatch { block, match.column, match.length, term });
+                }
+            }
+        }
+
+        for (int term : regExpTerms)
+        {
+            QRegularExpressionMatchIterator it = input.terms[term].regExp.globalMatch(text);
+            while (it.hasNext())
+            {
+                QRegularExpressionMatch m = it.next();
+                if (m.capturedLength() > 0)
+                {
+                    matches.push_back(CoolScrollSearchMatch { block, m.capturedStart(),
+                                                              m.capturedLength(), term });
+                }
+            }
+        }
+
+        for (const CoolScrollSearchMatch& match : matches)
+        {
+            result.areas[match.term].add(coolScrollMatchRect(input, text, match));
+        }
+        return true;
+    }, next);
+    return result;
+}
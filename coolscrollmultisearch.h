@@ -0,0 +1,139 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef COOLSCROLLMULTISEARCH_H
+#define COOLSCROLLMULTISEARCH_H
+
+#include <QColor>
+#include <QRectF>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+#include "coolscrolldocumentsnapshot.h"
+#include "coolscrollhighlightcoverage.h"
+#include "coolscrollwrapmodel.h"
+
+// term pinned by user; regExp is used instead of text when it has a pattern.
+// Plain terms match case-insensitively anywhere, whole word terms only as
+// an identifier token with the same case, as the token index finds them.
+struct CoolScrollHighlightTerm
+{
+    QString text;
+    QRegularExpression regExp;
+    QColor color;
+    bool wholeWord = false;
+
+    inline bool isRegExp() const { return !regExp.pattern().isEmpty(); }
+};
+
+struct CoolScrollSearchMatch
+{
+    int block;
+    int column;
+    int length;
+    int term;
+};
+
+// Aho-Corasick automaton over UTF-16 code units,
+// finds all added terms in a single pass over the text
+class CoolScrollMultiSearch
+{
+public:
+    explicit CoolScrollMultiSearch(Qt::CaseSensitivity cs = Qt::CaseInsensitive);
+
+    // returns index of the term reported in matches; of terms equal after
+    // case folding only the first one is reported, so add each once
+    int addTerm(const QString& term);
+    void build();
+
+    inline bool isEmpty() const { return m_termLengths.isEmpty(); }
+
+    void search(const QString& text, int block, QVector<CoolScrollSearchMatch>& matches) const;
+
+private:
+
+    struct Edge
+    {
+        ushort symbol;
+        int target;
+    };
+
+    struct Node
+    {
+        QVector<Edge> edges; // sorted by symbol
+        int fail = 0;
+        int term = -1;
+        int outputLink = -1; // nearest node on the fail chain which ends a term
+    };
+
+    ushort normalize(ushort c) const;
+    int findEdge(int node, ushort c) const;
+    int step(int state, ushort c) const;
+
+    Qt::CaseSensitivity m_caseSensitivity;
+    QVector<Node> m_nodes;
+    QVector<int> m_termLengths;
+    int m_rootAscii[128];
+};
+
+// everything a search needs, copied on GUI thread and handed to a worker
+struct CoolScrollSearchInput
+{
+    int generation = 0;
+    QVector<CoolScrollHighlightTerm> terms;
+    CoolScrollDocumentSnapshot snapshot;
+    CoolScrollWrapModel wrap;            // rows of the snapshot blocks
+    qreal charWidth = 1.0;               // of a display column in the scroll bar
+    qreal lineHeight = 1.0;
+    qreal minSelectionHeight = 1.0;
+    int scrollBarWidth = 0;
+    int visibleColumns = 0; // columns which fit into the scroll bar
+    int height = 0;
+    int firstRow = 0; // drawn at the top, a scrolling minimap shows a window of the rows
+};
+
+struct CoolScrollSearchResult
+{
+    int generation = 0;
+    int revision = 0; // of the searched snapshot
+    QVector<CoolScrollHighlightCoverage> areas; // one per term
+};
+
+// bounding rect of a match in scroll bar coordinates, placed by display
+// columns of its block and rows of the wrap model counted from the first row
+// of the window; matches past the visible columns are pinned to the right edge
+QRectF coolScrollMatchRect(const CoolScrollSearchInput& input, const QString& text,
+                           const CoolScrollSearchMatch& match);
+
+// runs all plain terms through one automaton and regular expressions
+// block by block; safe to call from a worker thread
+CoolScrollSearchResult coolScrollSearch(const CoolScrollSearchInput& input);
+
+#endif // COOLSCROLLMULTISEARCH_H
@@ -0,0 +1,225 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrolloutline.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // whitespace this wide may split runs, single spaces between words never do
+    const int l_minGapUnits = 2;
+    const int l_maxUnits = 0xFFFF;
+
+    inline int lowestBit(uint bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        int bit = 0;
+        while (!(bits & 1u)) { bits >>= 1; ++bit; }
+        return bit;
+#endif
+    }
+
+    // collects the first run start, the last run end and the widest gaps between them
+    struct GapCollector
+    {
+        enum { MaxGaps = CoolScrollOutline::MaxRuns - 1 };
+
+        int first = -1;
+        int lastEnd = -1;
+        int gapStarts[MaxGaps];
+        int gapEnds[MaxGaps];
+        int gaps = 0;
+
+        inline void runStarts(int index)
+        {
+            if (first < 0)
+            {
+                first = index;
+                return;
+            }
+            const int width = index - lastEnd;
+            if (width < l_minGapUnits) return;
+
+            // kept sorted by width, an earlier gap wins a tie
+            int at = gaps;
+            while (at > 0 && gapEnds[at - 1] - gapStarts[at - 1] < width) --at;
+            if (at == MaxGaps) return;
+            for (int i = qMin(gaps, MaxGaps - 1); i > at; --i)
+            {
+                gapStarts[i] = gapStarts[i - 1];
+                gapEnds[i] = gapEnds[i - 1];
+            }
+            gapStarts[at] = lastEnd;
+            gapEnds[at] = index;
+            gaps = qMin(gaps + 1, int(MaxGaps));
+        }
+
+        inline void runEnds(int index) { lastEnd = index; }
+
+        // bit i of nonSpace is set when unit base + i is not whitespace,
+        // previous tells whether the unit before base was not whitespace
+        inline void feed(uint nonSpace, int count, int base, bool& previous)
+        {
+            const uint all = (1u << count) - 1;
+            const uint transitions = (nonSpace ^ ((nonSpace << 1) | (previous ? 1u : 0u))) & all;
+            for (uint bits = transitions; bits != 0; bits &= bits - 1)
+            {
+                const int bit = lowestBit(bits);
+                if (nonSpace & (1u << bit)) runStarts(base + bit);
+                else runEnds(base + bit);
+            }
+            previous = (nonSpace >> (count - 1)) & 1u;
+        }
+    };
+}
+
+CoolScrollOutline CoolScrollOutline::scan(const QChar* data, int size)
+{
+    const ushort* units = reinterpret_cast<const ushort*>(data);
+    size = qMin(size, l_maxUnits);
+
+    // tabs, spaces and control characters are whitespace, i.e. units up to 0x20
+    GapCollector collector;
+    bool previous = false;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i space = _mm_set1_epi16(short(0x20));
+    for (; i + 8 <= size; i += 8)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i));
+        const __m128i white = _mm_cmpeq_epi16(_mm_subs_epu16(v, space), zero);
+        const uint nonSpace = ~uint(_mm_movemask_epi8(_mm_packs_epi16(white, white))) & 0xFF;
+        // indentation and code without double spaces skip the bit loop
+        if (nonSpace == (previous ? 0xFFu : 0u)) continue;
+        collector.feed(nonSpace, 8, i, previous);
+    }
+#endif
+    for (; i < size; i += 8)
+    {
+        const int count = qMin(8, size - i);
+        uint nonSpace = 0;
+        for (int bit = 0; bit < count; ++bit)
+        {
+            if (units[i + bit] > 0x20) nonSpace |= 1u << bit;
+        }
+        collector.feed(nonSpace, count, i, previous);
+    }
+    if (previous)
+    {
+        collector.runEnds(size);
+    }
+
+    CoolScrollOutline outline;
+    if (collector.first < 0) return outline;
+
+    // gaps in the order of the line, the runs lie between them
+    int gapStarts[GapCollector::MaxGaps];
+    int gapEnds[GapCollector::MaxGaps];
+    int gaps = 0;
+    for (int g = 0; g < collector.gaps; ++g)
+    {
+        int at = gaps++;
+        for (; at > 0 && gapStarts[at - 1] > collector.gapStarts[g]; --at)
+        {
+            gapStarts[at] = gapStarts[at - 1];
+            gapEnds[at] = gapEnds[at - 1];
+        }
+        gapStarts[at] = collector.gapStarts[g];
+        gapEnds[at] = collector.gapEnds[g];
+    }
+    int start = collector.first;
+    for (int g = 0; g < gaps; ++g)
+    {
+        outline.starts[outline.count] = quint16(start);
+        outline.ends[outline.count] = quint16(gapStarts[g]);
+        ++outline.count;
+        start = gapEnds[g];
+    }
+    outline.starts[outline.count] = quint16(start);
+    outline.ends[outline.count] = quint16(collector.lastEnd);
+    ++outline.count;
+    return outline;
+}
+
+int CoolScrollOutline::columns(const QString& text, CoolScrollTextColumns::Kind kind, int tabSize, int minGap,
+                               int* result) const
+{
+    if (count == 0) return 0;
+
+    // boundaries ascend, tabs are expanded in one walk up to the last of them
+    int boundaries[2 * MaxRuns];
+    for (int r = 0; r < count; ++r)
+    {
+        boundaries[2 * r] = starts[r];
+        boundaries[2 * r + 1] = ends[r];
+    }
+    if (kind == CoolScrollTextColumns::AsciiTabs)
+    {
+        tabSize = qMax(1, tabSize);
+        const ushort* units = reinterpret_cast<const ushort*>(text.constData());
+        int column = 0;
+        int index = 0;
+        for (int b = 0; b < 2 * count; ++b)
+        {
+            for (; index < boundaries[b]; ++index)
+            {
+                column = units[index] == '\t' ? (column / tabSize + 1) * tabSize : column + 1;
+            }
+            boundaries[b] = column;
+        }
+    }
+    else if (kind == CoolScrollTextColumns::Unicode)
+    {
+        for (int b = 0; b < 2 * count; ++b)
+        {
+            boundaries[b] = CoolScrollTextColumns::columnOf(text, boundaries[b], kind, tabSize);
+        }
+    }
+
+    int written = 0;
+    result[0] = boundaries[0];
+    result[1] = boundaries[1];
+    for (int r = 1; r < count; ++r)
+    {
+        if (minGap > 0 && boundaries[2 * r] - result[2 * written + 1] >= minGap)
+        {
+            ++written;
+            result[2 * written] = boundaries[2 * r];
+        }
+        result[2 * written + 1] = boundaries[2 * r + 1];
+    }
+    return written + 1;
+}
@@ -0,0 +1,60 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLOUTLINE_H
+#define COOLSCROLLOUTLINE_H
+
+#include <QString>
+
+#include "coolscrolltextcolumns.h"
+
+// Runs of non-whitespace code units of a line, the shape of code without
+// its characters. A line keeps at most MaxRuns runs: they are split at its
+// widest whitespace gaps, narrower gaps stay inside a run.
+struct CoolScrollOutline
+{
+    enum { MaxRuns = 3 };
+
+    quint16 starts[MaxRuns]; // code units, lines are looked at up to 65535 of them
+    quint16 ends[MaxRuns];
+    quint8 count = 0;        // 0 for a blank line
+
+    // a single pass, eight UTF-16 code units at a time with SSE2
+    static CoolScrollOutline scan(const QChar* data, int size);
+    static inline CoolScrollOutline scan(const QString& text) { return scan(text.constData(), text.size()); }
+
+    // runs in display columns as start, end pairs; runs closer than minGap
+    // columns are joined, 0 joins all of them into one bar from the first to
+    // the last non-whitespace column; returns the number of runs written
+    int columns(const QString& text, CoolScrollTextColumns::Kind kind, int tabSize, int minGap,
+                int* columns) const;
+};
+
+#endif // COOLSCROLLOUTLINE_H
@@ -34,6 +34,7 @@
 #include <coreplugin/icontext.h>
 #include <coreplugin/actionmanager/actionmanager.h>
 #include <coreplugin/editormanager/editormanager.h>
+#include <coreplugin/editormanager/documentmodel.h>
 #include <coreplugin/actionmanager/command.h>
 #include <coreplugin/actionmanager/actioncontainer.h>
 #include <coreplugin/coreconstants.h>
@@ -41,6 +42,8 @@
 #include <texteditor/texteditor.h>
 #include <texteditor/texteditorsettings.h>
 
+#include <QApplication>
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QScrollBar>
 #include <QPushButton>
@@ -50,20 +53,30 @@
 
 #include "coolscrollbarsettings.h"
 #include "coolscrollbar.h"
+#include "coolscrollmetrics.h"
+#include "coolscrollrenderer.h"
+#include "coolscrollscheduler.h"
 #include "settingspage.h"
 
 namespace
 {
     const QString l_nSettingsGroup(QStringLiteral("CoolScroll"));
+    // set to print the metrics report on shutdown, it is shown in the settings page otherwise
+    const char l_metricsEnvironment[] = "COOLSCROLL_METRICS";
 }
 
 using namespace CoolScroll::Internal;
 
 CoolScrollPlugin::CoolScrollPlugin() :
     ExtensionSystem::IPlugin(),
-    m_settings(new CoolScrollbarSettings)
+    m_settings(new CoolScrollbarSettings),
+    m_metrics(new CoolScrollMetrics),
+    m_scheduler(new CoolScrollScheduler(m_metrics)),
+    m_idle(false)
 {
     readSettings();
+    m_idleTimer.setSingleShot(true);
+    connect(&m_idleTimer, &QTimer::timeout, this, &CoolScrollPlugin::idleTimeout);
 }
 
 CoolScrollPlugin::~CoolScrollPlugin()
@@ -77,7 +90,9 @@ bool CoolScrollPlugin::initialize(const QStringList &arguments, QString *errorSt
     Q_UNUSED(arguments);
     Q_UNUSED(errorString);
 
-    SettingsPage* settingsPage = new SettingsPage(m_settings);
+    CoolScrollRenderer::setThreadPool(m_scheduler->threadPool());
+
+    SettingsPage* settingsPage = new SettingsPage(m_settings, m_metrics);
     connect(settingsPage, SIGNAL(settingsChanged()), SLOT(settingChanged()));
     addAutoReleasedObject(settingsPage);
 
@@ -98,6 +113,7 @@ void CoolScrollPlugin::extensionsInitialized()
     // Retrieve objects from the plugin manager's object pool
     // "In the extensionsInitialized method, a plugin can be sure that all
     //  plugins that depend on it are completely initialized."
+    userActivity();
 }
 
 ExtensionSystem::IPlugin::ShutdownFlag CoolScrollPlugin::aboutToShutdown()
@@ -106,7 +122,15 @@ ExtensionSystem::IPlugin::ShutdownFlag CoolScrollPlugin::aboutToShutdown()
     // Disconnect from signals that are not needed during shutdown
     // Hide UI (if you add UI that is not in the main window directly)
     disconnect(Core::EditorManager::instance(), 0, this, 0);
+    m_idleTimer.stop();
+    m_idle = false;
+    if (qEnvironmentVariableIsSet(l_metricsEnvironment))
+    {
+        qDebug() << "CoolScroll metrics:\n" << qPrintable(m_metrics->report());
+    }
+    CoolScrollRenderer::setThreadPool(nullptr);
     m_openedEditorsScrollbarsMap.clear();
+    m_pendingEditors.clear();
     saveSettings();
     return SynchronousShutdown;
 }
@@ -116,13 +140,73 @@ void CoolScrollPlugin::editorCreated(Core::IEditor *editor, const QString &fileN
 {
     Q_UNUSED(fileName);
 
-    TextEditor::TextEditorWidget* newEditor = qobject_cast<TextEditor::TextEditorWidget*>(editor->widget());
-    if (newEditor)
+    QElapsedTimer timer;
+    timer.start();
+
+    // editors restored with a session may never be shown, the scroll bar
+    // is created when the editor becomes visible for the first time; input
+    // in text editors ends idle time, keys go to the editor, the mouse to its viewport
+    if (auto textEditor = qobject_cast<TextEditor::TextEditorWidget*>(editor->widget()))
     {
-        CoolScrollBar* newScrollBar = new CoolScrollBar(newEditor, m_settings);
-        m_openedEditorsScrollbarsMap.insert( { editor , newScrollBar } );
-        newEditor->setVerticalScrollBar(newScrollBar);
+        m_pendingEditors.insert(textEditor, editor);
+        textEditor->installEventFilter(this);
+        textEditor->viewport()->installEventFilter(this);
+        updateEditorsMetrics();
     }
+    m_metrics->addSample(QStringLiteral("plugin.editor_created.usec"), timer.nsecsElapsed() / 1000);
+}
+
+bool CoolScrollPlugin::eventFilter(QObject *obj, QEvent *e)
+{
+    switch (e->type())
+    {
+    case QEvent::KeyPress:
+    case QEvent::MouseButtonPress:
+    case QEvent::Wheel:
+        userActivity();
+        break;
+    default:
+        break;
+    }
+
+    if (e->type() == QEvent::Show)
+    {
+        auto lookupIter = m_pendingEditors.find(obj);
+        if (lookupIter != m_pendingEditors.end())
+        {
+            createScrollBar(lookupIter.value());
+        }
+    }
+    return false;
+}
+
+CoolScrollBar *CoolScrollPlugin::createScrollBar(Core::IEditor *editor)
+{
+    auto lookupIter = m_pendingEditors.find(editor->widget());
+    if (lookupIter == m_pendingEditors.end())
+    {
+        return scrollBarForEditor(editor);
+    }
+    m_pendingEditors.erase(lookupIter);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    TextEditor::TextEditorWidget* newEditor = qobject_cast<TextEditor::TextEditorWidget*>(editor->widget());
+    CoolScrollBar* newScrollBar = new CoolScrollBar(newEditor, m_settings, m_metrics, m_scheduler);
+    m_openedEditorsScrollbarsMap.insert( { editor , newScrollBar } );
+    newEditor->setVerticalScrollBar(newScrollBar);
+    connect(newScrollBar, &CoolScrollBar::prewarmFinished, this, &CoolScrollPlugin::prewarmNext);
+
+    m_metrics->addSample(QStringLiteral("plugin.bar_created.usec"), timer.nsecsElapsed() / 1000);
+    updateEditorsMetrics();
+    return newScrollBar;
+}
+
+void CoolScrollPlugin::updateEditorsMetrics()
+{
+    m_metrics->setValue(QStringLiteral("plugin.editors.deferred"), m_pendingEditors.size());
+    m_metrics->setValue(QStringLiteral("plugin.editors.with_bar"), qint64(m_openedEditorsScrollbarsMap.size()));
 }
 
 void CoolScrollPlugin::currentEditorAboutToChange(Core::IEditor *editor)
@@ -138,10 +222,12 @@ void CoolScrollPlugin::currentEditorChanged(Core::IEditor *editor)
 {
     if (editor != nullptr)
     {
-        auto lookupIter = m_openedEditorsScrollbarsMap.find(editor);
-        if (lookupIter != m_openedEditorsScrollbarsMap.end())
+        m_recentEditors.removeOne(editor);
+        m_recentEditors.prepend(editor);
+        CoolScrollBar* bar = createScrollBar(editor);
+        if (bar)
         {
-            lookupIter->second->activate();
+            bar->activate();
         }
     }
 }
@@ -153,6 +239,114 @@ void CoolScrollPlugin::editorAboutToClose(Core::IEditor *editor)
     {
         m_openedEditorsScrollbarsMap.erase(lookupIter);
     }
+    m_pendingEditors.remove(editor->widget());
+    m_recentEditors.removeOne(editor);
+    updateEditorsMetrics();
+}
+
+void CoolScrollPlugin::userActivity()
+{
+    m_idle = false;
+    if (m_prewarming)
+    {
+        m_prewarming->cancelPrewarm();
+        m_prewarming = nullptr;
+    }
+
+    if (m_settings->prewarmIdle > 0)
+        m_idleTimer.start(m_settings->prewarmIdle);
+    else
+        m_idleTimer.stop();
+}
+
+void CoolScrollPlugin::idleTimeout()
+{
+    m_idle = true;
+    prewarmNext();
+}
+
+QList<Core::IEditor*> CoolScrollPlugin::prewarmCandidates() const
+{
+    QList<Core::IEditor*> editors;
+    Core::IEditor* current = Core::EditorManager::currentEditor();
+    if (current)
+        editors.append(current);
+    for (Core::IEditor* editor : m_recentEditors)
+    {
+        if (editor != current)
+            editors.append(editor);
+    }
+    // never current ones follow in the order of the open documents list
+    for (Core::DocumentModel::Entry* entry : Core::DocumentModel::entries())
+    {
+        if (!entry->document) continue;
+        for (Core::IEditor* editor : Core::DocumentModel::editorsForDocument(entry->document))
+        {
+            if (!editors.contains(editor))
+                editors.append(editor);
+        }
+    }
+    return editors;
+}
+
+void CoolScrollPlugin::prewarmNext()
+{
+    // one editor at a time, so that input stops prewarming right away
+    m_prewarming = nullptr;
+    if (!m_idle) return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // pictures are kept in the order of use until the budget is spent, hidden
+    // editors beyond it give theirs up and are not prewarmed
+    const qint64 budget = qint64(m_settings->memoryBudget) * 1024 * 1024;
+    qint64 used = 0;
+    bool full = false;
+    int released = 0;
+    for (Core::IEditor* editor : prewarmCandidates())
+    {
+        // editors never shown get their bar now, it is sized from the editor
+        CoolScrollBar* bar = scrollBarForEditor(editor);
+        if (!bar)
+        {
+            if (full || m_prewarming || !m_pendingEditors.contains(editor->widget())) continue;
+            bar = createScrollBar(editor);
+        }
+
+        if (!full && !m_prewarming)
+        {
+            const qint64 expected = bar->expectedContentBytes();
+            full = used + expected > budget;
+            if (!full && bar->prewarm())
+            {
+                m_prewarming = bar;
+                used += expected;
+                continue;
+            }
+        }
+
+        // measured after prewarm(), which may have loaded a picture from disk
+        const qint64 bytes = bar->contentBytes();
+        if (used + bytes > budget && editor != Core::EditorManager::currentEditor())
+        {
+            if (bytes > 0)
+            {
+                bar->releaseContent();
+                ++released;
+            }
+            full = true;
+            continue;
+        }
+        used += bytes;
+    }
+
+    m_metrics->setValue(QStringLiteral("prewarm.budget_used.bytes"), used);
+    if (released > 0)
+    {
+        m_metrics->addSample(QStringLiteral("prewarm.released"), released);
+    }
+    m_metrics->addSample(QStringLiteral("prewarm.walk.usec"), timer.nsecsElapsed() / 1000);
 }
 
 void CoolScroll::Internal::CoolScrollPlugin::readSettings()
@@ -188,25 +382,11 @@ CoolScrollBar *CoolScrollPlugin::scrollBarForEditor(Core::IEditor *editor)
 void CoolScroll::Internal::CoolScrollPlugin::settingChanged()
 {
     saveSettings();
-    Core::EditorManager* em = Core::EditorManager::instance();
-    auto lookupCurrent = m_openedEditorsScrollbarsMap.find(em->currentEditor());
-    if (lookupCurrent != m_openedEditorsScrollbarsMap.end())
-    {
-        lookupCurrent->second->applySettings();
-    }
-
-//    QList<Core::IEditor*> editors = em->documentModel()->oneEditorForEachOpenedDocument();
-//    QList<Core::IEditor*>::iterator it = editors.begin();
-//    // editors will update settings after next opening
-//    for( ; it != editors.end(); ++it)
-//    {
-//        CoolScrollBar* bar = getEditorScrollBar(*it);
-//        Q_ASSERT(bar);
-//        bar->markStateDirty();
-//    }
-//    // update current editor right now
-//    CoolScrollBar* bar = getEditorScrollBar(em->currentEditor());
-//    Q_ASSERT(bar);
-//    bar->fullUpdateSettings();
-//    mCoolScrollBar->fullUpdateSettings();
+    userActivity();
+    // active bars apply changed generations now, hidden ones when activated;
+    // this only compares counters, so it is cheap for any number of editors
+    for (const auto& editorBar : m_openedEditorsScrollbarsMap)
+    {
+        editorBar.second->applySettings();
+    }
 }
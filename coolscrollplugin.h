@@ -35,10 +35,16 @@
 #include <extensionsystem/iplugin.h>
 #include <coreplugin/editormanager/ieditor.h>
 
+#include <QHash>
+#include <QList>
+#include <QPointer>
 #include <QSharedPointer>
+#include <QTimer>
 #include <unordered_map>
 
 class CoolScrollbarSettings;
+class CoolScrollMetrics;
+class CoolScrollScheduler;
 class CoolScrollBar;
 class QScrollBar;
 
@@ -57,15 +63,36 @@ public:
     void extensionsInitialized();
     ShutdownFlag aboutToShutdown();
 
+    bool eventFilter(QObject *obj, QEvent *e);
+
 private:
     void readSettings();
     void saveSettings();
 
     QSharedPointer<CoolScrollbarSettings> m_settings;
+    QSharedPointer<CoolScrollMetrics> m_metrics;
+    // background work of all editors goes through one queue
+    QSharedPointer<CoolScrollScheduler> m_scheduler;
 
     CoolScrollBar* scrollBarForEditor(Core::IEditor* editor);
+    CoolScrollBar* createScrollBar(Core::IEditor* editor);
+    void updateEditorsMetrics();
+
+    // restarts the wait for idle time and stops prewarming
+    void userActivity();
+    // the current editor, then the most recently used ones, then the other open ones
+    QList<Core::IEditor*> prewarmCandidates() const;
 
     std::unordered_map<Core::IEditor*, CoolScrollBar*> m_openedEditorsScrollbarsMap;
+    // editors which were never shown yet, keyed by their widget
+    QHash<QObject*, Core::IEditor*> m_pendingEditors;
+    // editors in the order they were current, the most recent first
+    QList<Core::IEditor*> m_recentEditors;
+
+    // pictures of hidden editors are rendered while the user does nothing
+    QTimer m_idleTimer;
+    bool m_idle;
+    QPointer<CoolScrollBar> m_prewarming;
 
 private slots:
 
@@ -74,6 +101,8 @@ private slots:
     void currentEditorChanged(Core::IEditor *editor);
     void editorAboutToClose(Core::IEditor *editor);
     void settingChanged();
+    void idleTimeout();
+    void prewarmNext();
 };
 
 } // namespace Internal
@@ -0,0 +1,118 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrollqualitygovernor.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    // renders over budget in a row before a cheaper detail is chosen
+    const int l_stepDownFrames = 2;
+    // renders in a row under l_stepUpRatio of the budget before a richer one is tried
+    const int l_stepUpFrames = 8;
+    const qreal l_stepUpRatio = 0.5;
+    // a richer detail measured before must fit into this part of the budget
+    const qreal l_knownCostRatio = 0.8;
+}
+
+CoolScrollQualityGovernor::CoolScrollQualityGovernor() :
+    m_detail(CoolScrollRenderer::TextDetail),
+    m_overBudget(0),
+    m_underBudget(0)
+{
+    std::fill(std::begin(m_cost), std::end(m_cost), 0);
+}
+
+bool CoolScrollQualityGovernor::addFrame(CoolScrollRenderer::Detail detail, qint64 usec, qint64 budgetUsec)
+{
+    qint64& cost = m_cost[detail];
+    cost = cost > 0 ? (3 * cost + usec) / 4 : usec;
+
+    // the renderer may draw less than preferred, e.g. no text at small line
+    // heights; steps are taken from what was drawn, so each one shows
+    const CoolScrollRenderer::Detail drawn = qMax(m_detail, detail);
+    if (usec > budgetUsec)
+    {
+        m_underBudget = 0;
+        if (++m_overBudget >= l_stepDownFrames && drawn < CoolScrollRenderer::OutlineDetail)
+        {
+            m_detail = CoolScrollRenderer::Detail(drawn + 1);
+            m_overBudget = 0;
+            return true;
+        }
+    }
+    else if (usec < budgetUsec * l_stepUpRatio)
+    {
+        m_overBudget = 0;
+        // a richer preference would not be drawn while the renderer holds it back
+        if (++m_underBudget >= l_stepUpFrames && drawn == m_detail && m_detail > CoolScrollRenderer::TextDetail)
+        {
+            m_underBudget = 0;
+            const CoolScrollRenderer::Detail richer = CoolScrollRenderer::Detail(m_detail - 1);
+            const qint64 known = m_cost[richer];
+            if (known == 0 || known < budgetUsec * l_knownCostRatio)
+            {
+                m_detail = richer;
+                return true;
+            }
+            // the document may have shrunk since, retry later
+            m_cost[richer] = known / 2;
+        }
+    }
+    else
+    {
+        m_overBudget = 0;
+        m_underBudget = 0;
+    }
+    return false;
+}
+
+QString CoolScrollQualityGovernor::detailName(CoolScrollRenderer::Detail detail)
+{
+    switch (detail)
+    {
+    case CoolScrollRenderer::TextDetail:
+        return QCoreApplication::translate("CoolScroll", "full text");
+    case CoolScrollRenderer::GlyphDetail:
+        return QCoreApplication::translate("CoolScroll", "pixel glyphs");
+    case CoolScrollRenderer::BlockDetail:
+        return QCoreApplication::translate("CoolScroll", "outline bars");
+    case CoolScrollRenderer::DensityDetail:
+        return QCoreApplication::translate("CoolScroll", "density only");
+    case CoolScrollRenderer::OutlineDetail:
+        return QCoreApplication::translate("CoolScroll", "indentation outline");
+    default:
+        return QString();
+    }
+}
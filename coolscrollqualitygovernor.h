@@ -0,0 +1,63 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLQUALITYGOVERNOR_H
+#define COOLSCROLLQUALITYGOVERNOR_H
+
+#include <QString>
+
+#include "coolscrollrenderer.h"
+
+// Chooses the level of detail of the document picture from measured render
+// times. Steps to a cheaper detail after a few renders over the budget and
+// back to a richer one only after many renders well under it, and only if
+// the richer detail was not known to be too slow, so it does not flap.
+class CoolScrollQualityGovernor
+{
+public:
+    CoolScrollQualityGovernor();
+
+    inline CoolScrollRenderer::Detail detail() const { return m_detail; }
+
+    // detail is the one the render actually used, returns true when the
+    // preferred detail changed and the picture should be rendered again
+    bool addFrame(CoolScrollRenderer::Detail detail, qint64 usec, qint64 budgetUsec);
+
+    static QString detailName(CoolScrollRenderer::Detail detail);
+
+private:
+
+    CoolScrollRenderer::Detail m_detail;
+    qint64 m_cost[CoolScrollRenderer::DetailCount]; // smoothed, 0 when not measured
+    int m_overBudget;
+    int m_underBudget;
+};
+
+#endif // COOLSCROLLQUALITYGOVERNOR_H
@@ -0,0 +1,625 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrollrenderer.h"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const qreal l_maxLineHeight = 2.0;
+    const QString l_sampleString = "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX";
+
+    // text below this height in physical pixels is not readable anyway
+    const qreal l_minTextLineHeight = 2.5;
+    // mark at the right edge of lines longer than the visible columns
+    const qreal l_continuationWidth = 2.0;
+
+    // bands shorter than this are not worth a task
+    const int l_minBandRows = 16;
+    const int l_maxBandRows = 1024;
+    // a band is tuned to take between these times, shorter ones are
+    // dominated by scheduling, longer ones balance badly between cores
+    const qint64 l_minBandUsec = 500;
+    const qint64 l_maxBandUsec = 4000;
+
+    // renders of hidden editors run on workers, so the tuning is shared atomically
+    QAtomicInt s_bandRows(128);
+    // set from the GUI thread before any render
+    QThreadPool* s_threadPool = nullptr;
+
+    // a drawn pixel is a blend of two colors, this many steps of it are kept
+    const int l_paletteSize = 256;
+
+    struct Band
+    {
+        int top;
+        int bottom;
+        qint64 usec;
+    };
+
+    // bands are taken in order by the rendering thread and by pool workers;
+    // a worker which starts after all bands are taken returns at once, so the
+    // rendering thread never waits for a worker stuck behind other jobs
+    struct BandQueue
+    {
+        QVector<Band> bands;
+        QAtomicInt next;
+        QSemaphore painted;
+        std::function<void(Band&)> paint;
+
+        void drain()
+        {
+            for (int i = next.fetchAndAddRelaxed(1); i < bands.size(); i = next.fetchAndAddRelaxed(1))
+            {
+                paint(bands[i]);
+                painted.release();
+            }
+        }
+    };
+
+    class BandWorker : public QRunnable
+    {
+    public:
+        explicit BandWorker(const QSharedPointer<BandQueue>& queue) : m_queue(queue) {}
+        void run() override { m_queue->drain(); }
+
+    private:
+        QSharedPointer<BandQueue> m_queue;
+    };
+
+    // ahead of any other job queued in a shared pool, the GUI thread waits for bands
+    const int l_bandPriority = 1000;
+
+    // palette index of a pixel fully covered by outline bars
+    const int l_outlineIndex = 128;
+
+    // Coverage of outline bars over the pixels of a band in 1/256 of a pixel,
+    // kept as differences along each pixel row, so a bar costs two additions
+    // per row however long it is and lines thinner than a pixel add up.
+    class OutlineRaster
+    {
+    public:
+        OutlineRaster(int top, int bottom, int width, qreal lineHeight, qreal charWidth) :
+            m_top(top),
+            m_height(bottom - top),
+            m_width(width),
+            m_lineHeight(lineHeight),
+            m_charWidth(charWidth),
+            m_deltas((width + 1) * (bottom - top), 0)
+        {
+        }
+
+        // row from the top of the picture, columns from the left edge
+        void addBar(int row, int startColumn, int endColumn)
+        {
+            const int left = int(startColumn * m_charWidth);
+            if (left >= m_width) return;
+            const int right = qBound(left + 1, int(std::ceil(endColumn * m_charWidth)), m_width);
+
+            const qreal top = row * m_lineHeight - m_top;
+            const qreal bottom = top + m_lineHeight;
+            const int last = qMin(m_height, int(std::ceil(bottom)));
+            for (int y = qMax(0, int(top)); y < last; ++y)
+            {
+                const int weight = int(256 * (qMin(bottom, y + 1.0) - qMax(top, qreal(y))) + 0.5);
+                int* deltas = m_deltas.data() + y * (m_width + 1);
+                deltas[left] += weight;
+                deltas[right] -= weight;
+            }
+        }
+
+        // straight into the band's scanlines of the picture
+        void reduce(uchar* bits, int bytesPerLine) const
+        {
+            for (int y = 0; y < m_height; ++y)
+            {
+                const int* deltas = m_deltas.constData() + y * (m_width + 1);
+                uchar* line = bits + (m_top + y) * bytesPerLine;
+                int coverage = 0;
+                for (int x = 0; x < m_width; ++x)
+                {
+                    coverage += deltas[x];
+                    line[x] = uchar(qMin(coverage, 256) * l_outlineIndex / 256);
+                }
+            }
+        }
+
+    private:
+        int m_top;
+        int m_height;
+        int m_width;
+        qreal m_lineHeight; // physical pixels
+        qreal m_charWidth;  // physical pixels
+        QVector<int> m_deltas;
+    };
+}
+
+// Maps ARGB pixels painted with the two render colors back to the blend
+// step, read off the channel where the colors differ the most.
+struct CoolScrollRenderer::Quantizer
+{
+    explicit Quantizer(const CoolScrollRenderParams& params)
+    {
+        const QRgb background = params.background.rgba();
+        const QRgb foreground = params.foreground.rgba();
+        shift = 0;
+        int range = 0;
+        for (int channelShift : { 16, 8, 0, 24 })
+        {
+            const int difference = int((foreground >> channelShift) & 0xff) - int((background >> channelShift) & 0xff);
+            if (qAbs(difference) > qAbs(range))
+            {
+                range = difference;
+                shift = channelShift;
+            }
+        }
+        const int from = (background >> shift) & 0xff;
+        for (int value = 0; value < 256; ++value)
+        {
+            const int step = range == 0 ? 0 : ((value - from) * 255 + range / 2) / range;
+            steps[value] = uchar(qBound(0, step, l_paletteSize - 1));
+        }
+    }
+
+    inline void reduce(const QRgb* source, uchar* target, int width) const
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            target[x] = steps[(source[x] >> shift) & 0xff];
+        }
+    }
+
+    int shift;
+    uchar steps[256];
+};
+
+CoolScrollRenderer::Detail CoolScrollRenderer::detail(const CoolScrollRenderParams& params)
+{
+    const Detail byHeight = params.lineHeight * params.devicePixelRatio < l_minTextLineHeight ? BlockDetail
+                                                                                           : TextDetail;
+    return Detail(qMax(int(byHeight), params.quality));
+}
+
+qreal CoolScrollRenderer::lineHeight(int height, int rows)
+{
+    const qreal lineHeight = static_cast<float>(height) / qMax(1, rows);
+    return qMin(lineHeight, l_maxLineHeight);
+}
+
+qreal CoolScrollRenderer::maxLineHeight()
+{
+    return l_maxLineHeight;
+}
+
+QFont CoolScrollRenderer::fitFont(QFont font, qreal lineHeight, int width, qreal* charWidth)
+{
+    font.setPointSizeF(lineHeight);
+    font.setStretch(QFont::Unstretched);
+    QFontMetricsF fm(font);
+    if (fm.width(l_sampleString) < width)
+    {
+        font.setStretch(int(100 * width / fm.width(l_sampleString)));
+    }
+    *charWidth = QFontMetricsF(font).width(l_sampleString) / l_sampleString.size();
+    return font;
+}
+
+int CoolScrollRenderer::maxLines(const CoolScrollRenderParams& params)
+{
+    return int(std::ceil(params.size.height() / params.lineHeight)) + 1;
+}
+
+int CoolScrollRenderer::visibleColumns(int width, qreal charWidth)
+{
+    return int(std::ceil(width / qMax(charWidth, 0.1))) + 1;
+}
+
+QImage CoolScrollRenderer::render(const CoolScrollDocumentSnapshot& snapshot, const CoolScrollWrapModel& wrap,
+                                  const CoolScrollRenderParams& params, CoolScrollRenderStats* stats)
+{
+    if (detail(params) == OutlineDetail)
+    {
+        // runs are cached in the snapshot, no row text is copied
+        return renderBands(params, stats, [&snapshot, &wrap, &params](uchar* bits, const QImage& image,
+                                                                     int top, int bottom)
+        {
+            renderOutlineBand(bits, image, top, bottom, snapshot, wrap, params);
+        });
+    }
+
+    QVector<quint8> kinds;
+    const QVector<QString> lines = wrap.rowTextsFrom(snapshot, params.firstRow, maxLines(params), &kinds);
+    return render(lines, kinds, params, stats);
+}
+
+QImage CoolScrollRenderer::render(const QVector<QString>& lines, const CoolScrollRenderParams& params,
+                                  CoolScrollRenderStats* stats)
+{
+    QVector<quint8> kinds;
+    kinds.reserve(lines.size());
+    for (const QString& line : lines)
+    {
+        kinds.push_back(CoolScrollTextColumns::classify(line));
+    }
+    return render(lines, kinds, params, stats);
+}
+
+QImage CoolScrollRenderer::render(const QVector<QString>& lines, const QVector<quint8>& kinds,
+                                  const CoolScrollRenderParams& params, CoolScrollRenderStats* stats)
+{
+    const Quantizer quantizer(params);
+    const Detail lineDetail = detail(params);
+    return renderBands(params, stats, [&lines, &kinds, &params, &quantizer, lineDetail](uchar* bits,
+                                                                                        const QImage& image,
+                                                                                        int top, int bottom)
+    {
+        renderBand(bits, image, top, bottom, lines, kinds, params, quantizer, lineDetail);
+    });
+}
+
+QImage CoolScrollRenderer::renderBands(const CoolScrollRenderParams& params, CoolScrollRenderStats* stats,
+                                       const BandPainter& paint)
+{
+    const QSize physicalSize = (params.size * params.devicePixelRatio).expandedTo(QSize(1, 1));
+    QImage image(physicalSize, QImage::Format_Indexed8);
+    image.setColorTable(colorTable(params));
+    image.fill(0);
+
+    QThreadPool* pool = s_threadPool ? s_threadPool : QThreadPool::globalInstance();
+    const int threads = threadSafe(params) ? pool->maxThreadCount() + 1 : 1;
+
+    // every core gets at least one band even if the tuned height is larger
+    const int height = physicalSize.height();
+    const int rowsPerThread = (height + threads - 1) / threads;
+    const int bandRows = qMax(l_minBandRows, qMin(s_bandRows.load(), rowsPerThread));
+
+    QSharedPointer<BandQueue> queue(new BandQueue);
+    QVector<Band>& bands = queue->bands;
+    for (int top = 0; top < height; top += bandRows)
+    {
+        bands.push_back(Band { top, qMin(height, top + bandRows), 0 });
+    }
+
+    // bands paint disjoint scanlines of one buffer, nothing to composite afterwards;
+    // the buffer is detached here once, workers must not touch the image itself
+    uchar* bits = image.bits();
+    queue->paint = [bits, &image, &paint](Band& band)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        paint(bits, image, band.top, band.bottom);
+        band.usec = timer.nsecsElapsed() / 1000;
+    };
+    const int workers = qMin(threads, bands.size()) - 1;
+    for (int i = 0; i < workers; ++i)
+    {
+        pool->start(new BandWorker(queue), l_bandPriority);
+    }
+    queue->drain();
+    queue->painted.acquire(bands.size());
+
+    CoolScrollRenderStats bandStats;
+    bandStats.bands = bands.size();
+    bandStats.bandRows = bandRows;
+    for (const Band& band : bands)
+    {
+        bandStats.bandUsec += band.usec;
+        bandStats.maxBandUsec = qMax(bandStats.maxBandUsec, band.usec);
+    }
+    tuneBandRows(bandStats);
+    if (stats)
+    {
+        *stats = bandStats;
+    }
+
+    image.setDevicePixelRatio(params.devicePixelRatio);
+    return image;
+}
+
+QVector<QRgb> CoolScrollRenderer::colorTable(const CoolScrollRenderParams& params)
+{
+    // index i is the foreground blended over the background with alpha i / 255
+    const QRgb background = params.background.rgba();
+    const QRgb foreground = params.foreground.rgba();
+    auto blend = [](int from, int to, int i) { return from + ((to - from) * i + 127) / 255; };
+
+    QVector<QRgb> table(l_paletteSize);
+    for (int i = 0; i < l_paletteSize; ++i)
+    {
+        table[i] = qRgba(blend(qRed(background), qRed(foreground), i),
+                         blend(qGreen(background), qGreen(foreground), i),
+                         blend(qBlue(background), qBlue(foreground), i),
+                         blend(qAlpha(background), qAlpha(foreground), i));
+    }
+    return table;
+}
+
+void CoolScrollRenderer::setThreadPool(QThreadPool* pool)
+{
+    s_threadPool = pool;
+}
+
+int CoolScrollRenderer::bandRows()
+{
+    return s_bandRows.load();
+}
+
+bool CoolScrollRenderer::threadSafe(const CoolScrollRenderParams& params)
+{
+    // glyph rasterization may be bound to the GUI thread on some platforms
+    return detail(params) != TextDetail || QFontDatabase::supportsThreadedFontRendering();
+}
+
+void CoolScrollRenderer::renderBand(uchar* bits, const QImage& image, int top, int bottom,
+                                    const QVector<QString>& lines, const QVector<quint8>& kinds,
+                                    const CoolScrollRenderParams& params, const Quantizer& quantizer,
+                                    Detail detail)
+{
+    // painted in ARGB the height of the band, then reduced to palette indexes
+    // in the band's scanlines of the shared image
+    QImage band(image.width(), bottom - top, QImage::Format_ARGB32_Premultiplied);
+    band.fill(params.background);
+
+    const qreal dpr = params.devicePixelRatio;
+    const qreal baseline = params.lineHeight - QFontMetricsF(params.font).descent();
+    QPainter p(&band);
+    p.translate(0.0, -top);
+    p.scale(dpr, dpr);
+    p.setFont(params.font);
+    p.setPen(params.foreground);
+
+    // neighbour lines are drawn too, their glyphs may reach into the band
+    const qreal physicalLineHeight = params.lineHeight * dpr;
+    const int first = qMax(0, int(top / physicalLineHeight) - 1);
+    const int last = qMin(lines.size(), int(std::ceil(bottom / physicalLineHeight)) + 1);
+    const int columns = visibleColumns(params.size.width(), params.charWidth);
+    for (int i = first; i < last; ++i)
+    {
+        drawLine(p, lines[i], CoolScrollTextColumns::Kind(kinds[i]), columns, i * params.lineHeight,
+                 baseline, params, detail);
+    }
+    p.end();
+
+    for (int y = 0; y < band.height(); ++y)
+    {
+        quantizer.reduce(reinterpret_cast<const QRgb*>(band.constScanLine(y)),
+                         bits + (top + y) * image.bytesPerLine(), band.width());
+    }
+}
+
+void CoolScrollRenderer::renderOutlineBand(uchar* bits, const QImage& image, int top, int bottom,
+                                           const CoolScrollDocumentSnapshot& snapshot,
+                                           const CoolScrollWrapModel& wrap, const CoolScrollRenderParams& params)
+{
+    const qreal dpr = params.devicePixelRatio;
+    const qreal physicalLineHeight = params.lineHeight * dpr;
+    OutlineRaster raster(top, bottom, image.width(), physicalLineHeight, params.charWidth * dpr);
+
+    // rows of the wrap model reaching into the band, blocks above are skipped by chunks
+    const int firstRow = params.firstRow + int(top / physicalLineHeight);
+    const int endRow = qMin(wrap.rowCount(), params.firstRow + int(std::ceil(bottom / physicalLineHeight)));
+    if (firstRow < endRow && wrap.blockCount() == snapshot.blockCount())
+    {
+        const int wrapColumn = wrap.wrapColumn();
+        int block = wrap.blockAt(firstRow);
+        int row = wrap.firstRow(block);
+        snapshot.forEachOutline([&](const QString& text, bool, CoolScrollTextColumns::Kind kind,
+                                    const CoolScrollOutline& outline)
+        {
+            const int rows = wrap.rows(block++);
+            if (outline.count == 0)
+            {
+                row += rows;
+                return row < endRow;
+            }
+            int columns[2 * CoolScrollOutline::MaxRuns];
+            const int runs = outline.columns(text, kind, params.tabSize, params.outlineGap, columns);
+            for (int k = 0; k < rows && row < endRow; ++k, ++row)
+            {
+                if (row < firstRow) continue;
+
+                // a wrapped block shows the columns of each of its rows
+                const int from = rows > 1 ? k * wrapColumn : 0;
+                const int to = rows > 1 ? from + wrapColumn : std::numeric_limits<int>::max();
+                for (int r = 0; r < runs; ++r)
+                {
+                    const int start = qMax(columns[2 * r], from);
+                    const int end = qMin(columns[2 * r + 1], to);
+                    if (end > start)
+                    {
+                        raster.addBar(row - params.firstRow, start - from, end - from);
+                    }
+                }
+            }
+            return row < endRow;
+        }, block);
+    }
+    raster.reduce(bits, image.bytesPerLine());
+}
+
+void CoolScrollRenderer::drawLine(QPainter& p, const QString& fullText, CoolScrollTextColumns::Kind kind,
+                                  int columns, qreal y, qreal baseline,
+                                  const CoolScrollRenderParams& params, Detail detail)
+{
+    // a minified file may have lines of megabytes, only what fits is looked at
+    const int end = CoolScrollTextColumns::indexAt(fullText, columns, kind, params.tabSize);
+    const bool continues = end < fullText.size();
+    const QString text = continues ? fullText.left(end) : fullText;
+    if (continues)
+    {
+        QColor markColor = params.foreground;
+        markColor.setAlphaF(0.4);
+        p.fillRect(QRectF(params.size.width() - l_continuationWidth, y, l_continuationWidth,
+                          params.lineHeight), markColor);
+    }
+
+    if (detail == TextDetail)
+    {
+        // wide glyphs of a monospace font take two columns by themselves
+        p.drawText(QPointF(0.0, y + baseline),
+                   kind == CoolScrollTextColumns::Ascii ? text
+                                                        : CoolScrollTextColumns::expandTabs(text, params.tabSize));
+        return;
+    }
+
+    if (detail == OutlineDetail)
+    {
+        // rows handed over as text are scanned here, snapshots keep runs of their blocks
+        int runColumns[2 * CoolScrollOutline::MaxRuns];
+        const int runs = CoolScrollOutline::scan(text).columns(text, kind, params.tabSize, params.outlineGap,
+                                                               runColumns);
+        QColor outlineColor = params.foreground;
+        outlineColor.setAlpha(l_outlineIndex);
+        for (int r = 0; r < runs; ++r)
+        {
+            p.fillRect(QRectF(runColumns[2 * r] * params.charWidth, y,
+                              (runColumns[2 * r + 1] - runColumns[2 * r]) * params.charWidth, params.lineHeight),
+                       outlineColor);
+        }
+        return;
+    }
+
+    // x of a character is its display column, ASCII text needs no table
+    QVector<int> starts;
+    CoolScrollTextColumns::columnStarts(text, kind, params.tabSize, starts);
+    auto x = [&starts, &params](int index) -> qreal
+    {
+        return (starts.isEmpty() ? index : starts[index]) * params.charWidth;
+    };
+
+    QColor blockColor = params.foreground;
+    blockColor.setAlphaF(0.6);
+
+    if (detail == GlyphDetail)
+    {
+        drawGlyphs(p, text, starts, y, baseline, params, blockColor);
+        return;
+    }
+
+    if (detail == DensityDetail)
+    {
+        int first = 0;
+        while (first < text.size() && text.at(first).isSpace()) ++first;
+        int last = text.size();
+        while (last > first && text.at(last - 1).isSpace()) --last;
+        if (last > first)
+        {
+            blockColor.setAlphaF(0.35);
+            p.fillRect(QRectF(x(first), y, x(last) - x(first), params.lineHeight), blockColor);
+        }
+        return;
+    }
+
+    // one block per word
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i)
+    {
+        const bool space = (i == text.size()) || text.at(i).isSpace();
+        if (!space && start < 0)
+        {
+            start = i;
+        }
+        else if (space && start >= 0)
+        {
+            p.fillRect(QRectF(x(start), y, x(i) - x(start), params.lineHeight), blockColor);
+            start = -1;
+        }
+    }
+}
+
+void CoolScrollRenderer::drawGlyphs(QPainter& p, const QString& text, const QVector<int>& starts,
+                                    qreal y, qreal baseline, const CoolScrollRenderParams& params,
+                                    const QColor& color)
+{
+    // height of a glyph relative to the line: capitals, digits and letters
+    // with ascenders are tall, other letters short, punctuation is a dot
+    auto glyphHeight = [](QChar c) -> qreal
+    {
+        static const QString tall = QStringLiteral("bdfhklt");
+        if (c.isSpace()) return 0.0;
+        if (c.isUpper() || c.isDigit() || tall.contains(c)) return 0.7;
+        if (c.isLetter()) return 0.45;
+        return 0.25;
+    };
+
+    // runs of characters of the same height are drawn as one rect
+    const qreal bottom = y + baseline;
+    int start = 0;
+    qreal runHeight = text.isEmpty() ? 0.0 : glyphHeight(text.at(0));
+    for (int i = 1; i <= text.size(); ++i)
+    {
+        const qreal height = i < text.size() ? glyphHeight(text.at(i)) : -1.0;
+        if (height == runHeight) continue;
+
+        if (runHeight > 0.0)
+        {
+            const qreal h = runHeight * params.lineHeight;
+            const int left = starts.isEmpty() ? start : starts[start];
+            const int right = starts.isEmpty() ? i : starts[i];
+            p.fillRect(QRectF(left * params.charWidth, bottom - h, (right - left) * params.charWidth, h), color);
+        }
+        start = i;
+        runHeight = height;
+    }
+}
+
+void CoolScrollRenderer::tuneBandRows(const CoolScrollRenderStats& stats)
+{
+    if (stats.bands < 2) return;
+
+    // only bands cut to the tuned height say something about it
+    const int rows = s_bandRows.load();
+    if (stats.bandRows != rows) return;
+
+    // a concurrent render which tuned it first wins
+    const qint64 average = stats.bandUsec / stats.bands;
+    if (average < l_minBandUsec)
+    {
+        s_bandRows.testAndSetOrdered(rows, qMin(l_maxBandRows, rows * 2));
+    }
+    else if (average > l_maxBandUsec)
+    {
+        s_bandRows.testAndSetOrdered(rows, qMax(l_minBandRows, rows / 2));
+    }
+}
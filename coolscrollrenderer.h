@@ -0,0 +1,149 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLRENDERER_H
+#define COOLSCROLLRENDERER_H
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+#include <functional>
+
+#include "coolscrolldocumentsnapshot.h"
+#include "coolscrolltextcolumns.h"
+#include "coolscrollwrapmodel.h"
+
+class QPainter;
+class QString;
+class QThreadPool;
+
+struct CoolScrollRenderParams
+{
+    QSize size;                   // logical pixels
+    qreal devicePixelRatio = 1.0;
+    qreal lineHeight = 1.0;       // logical pixels per drawn line
+    int firstRow = 0;             // row of the wrap model drawn at the top
+    qreal charWidth = 1.0;        // logical pixels per display column
+    int tabSize = 4;
+    QFont font;
+    QColor background = Qt::white;
+    QColor foreground = Qt::black;
+    int quality = 0;              // CoolScrollRenderer::Detail, the richest one allowed
+    int outlineGap = 8;           // whitespace columns which split outline bars, 0 never splits
+};
+
+struct CoolScrollRenderStats
+{
+    int bands = 0;
+    int bandRows = 0;             // physical pixel rows per band
+    qint64 bandUsec = 0;          // sum over all bands
+    qint64 maxBandUsec = 0;
+};
+
+// Draws document content into an image allocated at physical resolution.
+// Line i occupies rows [i * lineHeight, (i + 1) * lineHeight) in logical pixels.
+// Large images are split into horizontal bands painted in parallel; each band
+// is reduced to palette indexes straight into the shared image buffer, so the
+// result takes a byte per pixel.
+class CoolScrollRenderer
+{
+public:
+    // level of detail from the richest to the cheapest
+    enum Detail
+    {
+        TextDetail,    // glyphs are readable enough to be drawn
+        GlyphDetail,   // a small rect per character, tall or short like the glyph
+        BlockDetail,   // one block per word
+        DensityDetail, // one bar per line spanning its text
+        OutlineDetail, // bars of cached non-whitespace runs, rasterized without a painter
+        DetailCount
+    };
+
+    // the richer of quality and what line height in physical pixels allows
+    static Detail detail(const CoolScrollRenderParams& params);
+
+    // rows share the height evenly, but are never taller than readable text needs
+    static qreal lineHeight(int height, int rows);
+    static qreal maxLineHeight();
+    // font sized to the line height and stretched so a sample line fills the width;
+    // charWidth receives the width of a column
+    static QFont fitFont(QFont font, qreal lineHeight, int width, qreal* charWidth);
+
+    // number of lines which fit into the image
+    static int maxLines(const CoolScrollRenderParams& params);
+    // display columns of a line which can be seen, the rest is never shaped or drawn
+    static int visibleColumns(int width, qreal charWidth);
+
+    // one line per row of the wrap model, from params.firstRow on
+    static QImage render(const CoolScrollDocumentSnapshot& snapshot, const CoolScrollWrapModel& wrap,
+                         const CoolScrollRenderParams& params, CoolScrollRenderStats* stats = nullptr);
+    // lines are classified here, the snapshot keeps kinds of its blocks
+    static QImage render(const QVector<QString>& lines, const CoolScrollRenderParams& params,
+                         CoolScrollRenderStats* stats = nullptr);
+
+    // whether bands may be painted off the GUI thread, and so the whole render
+    static bool threadSafe(const CoolScrollRenderParams& params);
+
+    // band height currently preferred, adjusted after every render by measured band times
+    static int bandRows();
+    // bands are painted by workers of this pool and the calling thread,
+    // the global pool is used when none is set
+    static void setThreadPool(QThreadPool* pool);
+
+    // palette of rendered images, from the background to the foreground
+    static QVector<QRgb> colorTable(const CoolScrollRenderParams& params);
+
+private:
+
+    struct Quantizer;
+    typedef std::function<void(uchar* bits, const QImage& image, int top, int bottom)> BandPainter;
+
+    // allocates the picture and lets paint fill its bands in parallel
+    static QImage renderBands(const CoolScrollRenderParams& params, CoolScrollRenderStats* stats,
+                              const BandPainter& paint);
+    static QImage render(const QVector<QString>& lines, const QVector<quint8>& kinds,
+                         const CoolScrollRenderParams& params, CoolScrollRenderStats* stats);
+    static void renderBand(uchar* bits, const QImage& image, int top, int bottom, const QVector<QString>& lines,
+                           const QVector<quint8>& kinds, const CoolScrollRenderParams& params,
+                           const Quantizer& quantizer, Detail detail);
+    static void renderOutlineBand(uchar* bits, const QImage& image, int top, int bottom,
+                                  const CoolScrollDocumentSnapshot& snapshot, const CoolScrollWrapModel& wrap,
+                                  const CoolScrollRenderParams& params);
+    static void drawLine(QPainter& p, const QString& text, CoolScrollTextColumns::Kind kind, int columns,
+                         qreal y, qreal baseline, const CoolScrollRenderParams& params, Detail detail);
+    static void drawGlyphs(QPainter& p, const QString& text, const QVector<int>& starts, qreal y, qreal baseline,
+                           const CoolScrollRenderParams& params, const QColor& color);
+    static void tuneBandRows(const CoolScrollRenderStats& stats);
+};
+
+#endif // COOLSCROLLRENDERER_H
@@ -0,0 +1,161 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrollscheduler.h"
+#include "coolscrollmetrics.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    const char* const l_priorityNames[] = { "active", "visible", "background", "prewarm" };
+    static_assert(sizeof(l_priorityNames) / sizeof(l_priorityNames[0]) == CoolScrollScheduler::PriorityCount,
+                  "every priority needs a name");
+
+    // share of the cores given to scroll bars, the rest is left to the IDE
+    const int l_coreShareDivisor = 2;
+}
+
+CoolScrollScheduler::CoolScrollScheduler(const QSharedPointer<CoolScrollMetrics>& metrics) :
+    m_metrics(metrics)
+{
+    m_clock.start();
+    setMaxThreadCount(QThread::idealThreadCount() / l_coreShareDivisor);
+}
+
+CoolScrollScheduler::~CoolScrollScheduler()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const QSharedPointer<Ticket>& ticket : m_queued)
+        {
+            ticket->canceled.store(1);
+        }
+        m_queued.clear();
+    }
+    m_pool.waitForDone();
+}
+
+void CoolScrollScheduler::setMaxThreadCount(int count)
+{
+    m_pool.setMaxThreadCount(qMax(1, count));
+    m_metrics->setValue(QStringLiteral("scheduler.threads"), m_pool.maxThreadCount());
+}
+
+int CoolScrollScheduler::maxThreadCount() const
+{
+    return m_pool.maxThreadCount();
+}
+
+void CoolScrollScheduler::cancelStale(const void* owner, int revision)
+{
+    cancel(owner, revision);
+}
+
+void CoolScrollScheduler::cancelAll(const void* owner)
+{
+    cancel(owner, std::numeric_limits<int>::max());
+}
+
+const char* CoolScrollScheduler::priorityName(Priority priority)
+{
+    return l_priorityNames[priority];
+}
+
+QSharedPointer<CoolScrollScheduler::Ticket> CoolScrollScheduler::enqueue(Priority priority, const void* owner,
+                                                                         int revision)
+{
+    QSharedPointer<Ticket> ticket(new Ticket);
+    ticket->owner = owner;
+    ticket->revision = revision;
+    ticket->priority = priority;
+    ticket->queuedNsecs = m_clock.nsecsElapsed();
+    ticket->canceled.store(0);
+
+    QMutexLocker locker(&m_mutex);
+    m_queued.push_back(ticket);
+    updateQueueMetrics();
+    return ticket;
+}
+
+void CoolScrollScheduler::dispatch(QRunnable* job, Priority priority)
+{
+    // the pool runs higher numbers first
+    m_pool.start(job, PriorityCount - priority);
+}
+
+bool CoolScrollScheduler::begin(const QSharedPointer<Ticket>& ticket)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto it = std::find(m_queued.begin(), m_queued.end(), ticket);
+    if (it != m_queued.end())
+    {
+        m_queued.erase(it);
+        updateQueueMetrics();
+    }
+    if (ticket->canceled.load()) return false;
+
+    const qint64 waitUsec = (m_clock.nsecsElapsed() - ticket->queuedNsecs) / 1000;
+    m_metrics->addSample(QStringLiteral("scheduler.wait.%1.usec").arg(QLatin1String(priorityName(ticket->priority))),
+                         waitUsec);
+    return true;
+}
+
+void CoolScrollScheduler::cancel(const void* owner, int revision)
+{
+    // dropped jobs leave the pool queue cheaply, begin() turns them away
+    QMutexLocker locker(&m_mutex);
+    int canceled = 0;
+    auto it = std::stable_partition(m_queued.begin(), m_queued.end(),
+                                    [owner, revision](const QSharedPointer<Ticket>& ticket)
+    {
+        return ticket->owner != owner || ticket->revision >= revision;
+    });
+    for (auto dropped = it; dropped != m_queued.end(); ++dropped)
+    {
+        (*dropped)->canceled.store(1);
+        ++canceled;
+    }
+    m_queued.erase(it, m_queued.end());
+    if (canceled > 0)
+    {
+        m_metrics->addSample(QStringLiteral("scheduler.canceled"), canceled);
+        updateQueueMetrics();
+    }
+}
+
+void CoolScrollScheduler::updateQueueMetrics()
+{
+    m_metrics->setValue(QStringLiteral("scheduler.queue_depth"), m_queued.size());
+    m_metrics->addSample(QStringLiteral("scheduler.depth"), m_queued.size());
+}
@@ -0,0 +1,184 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLSCHEDULER_H
+#define COOLSCROLLSCHEDULER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include <utility>
+
+class CoolScrollMetrics;
+
+// One queue for the background work of all scroll bars. Jobs run on a pool
+// capped below the core count, so the minimap never starves Qt Creator's own
+// threads, and in order of priority, so the editor being looked at is served
+// first. A queued job may be dropped when newer text makes it useless.
+class CoolScrollScheduler
+{
+public:
+    // from the most to the least urgent
+    enum Priority
+    {
+        ActiveEditor,
+        VisibleEditor,    // other splits on screen
+        BackgroundEditor,
+        Prewarm,
+        PriorityCount
+    };
+
+    explicit CoolScrollScheduler(const QSharedPointer<CoolScrollMetrics>& metrics);
+    // drops queued jobs and waits for running ones
+    ~CoolScrollScheduler();
+
+    void setMaxThreadCount(int count);
+    int maxThreadCount() const;
+    inline QThreadPool* threadPool() { return &m_pool; }
+
+    // queues a function; owner and revision tag the job for cancelStale(),
+    // a dropped job never runs and its future is reported canceled
+    template <typename Function>
+    auto run(Priority priority, const void* owner, int revision, Function function)
+        -> QFuture<decltype(function())>;
+
+    // drops queued jobs of the owner made for revisions before the given one
+    void cancelStale(const void* owner, int revision);
+    // drops all queued jobs of the owner, e.g. when its editor goes away
+    void cancelAll(const void* owner);
+
+    static const char* priorityName(Priority priority);
+
+private:
+
+    struct Ticket
+    {
+        const void* owner;
+        int revision;
+        Priority priority;
+        qint64 queuedNsecs;
+        QAtomicInt canceled;
+    };
+
+    template <typename T, typename Function>
+    class Job;
+
+    QSharedPointer<Ticket> enqueue(Priority priority, const void* owner, int revision);
+    void dispatch(QRunnable* job, Priority priority);
+    // called by a worker before the job runs, false if it was dropped
+    bool begin(const QSharedPointer<Ticket>& ticket);
+    void cancel(const void* owner, int revision);
+    void updateQueueMetrics();
+
+    const QSharedPointer<CoolScrollMetrics> m_metrics;
+    QThreadPool m_pool;
+    QElapsedTimer m_clock;
+    QMutex m_mutex;
+    QVector<QSharedPointer<Ticket>> m_queued;
+};
+
+namespace CoolScrollSchedulerDetail
+{
+    template <typename T>
+    struct Invoke
+    {
+        template <typename Function>
+        static void call(QFutureInterface<T>& future, Function& function)
+        {
+            const T result = function();
+            future.reportResult(result);
+        }
+    };
+
+    template <>
+    struct Invoke<void>
+    {
+        template <typename Function>
+        static void call(QFutureInterface<void>&, Function& function)
+        {
+            function();
+        }
+    };
+}
+
+template <typename T, typename Function>
+class CoolScrollScheduler::Job : public QRunnable
+{
+public:
+    Job(CoolScrollScheduler* scheduler, const QSharedPointer<Ticket>& ticket, Function function) :
+        m_scheduler(scheduler),
+        m_ticket(ticket),
+        m_function(std::move(function))
+    {
+        m_future.reportStarted();
+    }
+
+    inline QFuture<T> future() { return m_future.future(); }
+
+    void run() override
+    {
+        if (m_scheduler->begin(m_ticket))
+        {
+            CoolScrollSchedulerDetail::Invoke<T>::call(m_future, m_function);
+        }
+        else
+        {
+            m_future.reportCanceled();
+        }
+        m_future.reportFinished();
+    }
+
+private:
+
+    CoolScrollScheduler* m_scheduler;
+    QSharedPointer<Ticket> m_ticket;
+    Function m_function;
+    QFutureInterface<T> m_future;
+};
+
+template <typename Function>
+auto CoolScrollScheduler::run(Priority priority, const void* owner, int revision, Function function)
+    -> QFuture<decltype(function())>
+{
+    typedef decltype(function()) Result;
+    auto job = new Job<Result, Function>(this, enqueue(priority, owner, revision), std::move(function));
+    const QFuture<Result> future = job->future();
+    dispatch(job, priority);
+    return future;
+}
+
+#endif // COOLSCROLLSCHEDULER_H
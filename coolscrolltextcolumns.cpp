@@ -0,0 +1,306 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrolltextcolumns.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    struct Range
+    {
+        uint first;
+        uint last;
+    };
+
+    // abridged from EastAsianWidth.txt, W and F
+    constexpr Range l_wideRanges[] =
+    {
+        { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC },
+        { 0x23F0, 0x23F0 }, { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 },
+        { 0x2648, 0x2653 }, { 0x267F, 0x267F }, { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 },
+        { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 }, { 0x26CE, 0x26CE },
+        { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+        { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B },
+        { 0x2728, 0x2728 }, { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 },
+        { 0x2757, 0x2757 }, { 0x2795, 0x2797 }, { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF },
+        { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 }, { 0x2E80, 0x303E },
+        { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+        { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 },
+        { 0xFE30, 0xFE6F }, { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 },
+        { 0x16FE0, 0x16FE4 }, { 0x17000, 0x18AFF }, { 0x1B000, 0x1B2FF }, { 0x1F004, 0x1F004 },
+        { 0x1F0CF, 0x1F0CF }, { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A }, { 0x1F200, 0x1F2FF },
+        { 0x1F300, 0x1F64F }, { 0x1F680, 0x1F6FF }, { 0x1F900, 0x1F9FF }, { 0x20000, 0x2FFFD },
+        { 0x30000, 0x3FFFD }
+    };
+
+    // abridged from UnicodeData.txt, categories Mn, Me and Cf
+    constexpr Range l_zeroWidthRanges[] =
+    {
+        { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF },
+        { 0x05C1, 0x05C2 }, { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A },
+        { 0x064B, 0x065F }, { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 },
+        { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 }, { 0x0730, 0x074A },
+        { 0x07A6, 0x07B0 }, { 0x0900, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C },
+        { 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 }, { 0x0E31, 0x0E31 },
+        { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF },
+        { 0x200B, 0x200F }, { 0x202A, 0x202E }, { 0x2060, 0x2064 }, { 0x20D0, 0x20FF },
+        { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF }, { 0xE0100, 0xE01EF }
+    };
+
+    enum PageKind : quint8
+    {
+        NarrowPage,
+        WidePage,
+        ZeroWidthPage,
+        MixedPage
+    };
+
+    template <int N>
+    constexpr uint coveredInPage(const Range (&ranges)[N], uint page)
+    {
+        const uint first = page << 8;
+        const uint last = first | 0xFF;
+        uint covered = 0;
+        for (int i = 0; i < N; ++i)
+        {
+            const uint from = ranges[i].first > first ? ranges[i].first : first;
+            const uint to = ranges[i].last < last ? ranges[i].last : last;
+            if (from <= to)
+            {
+                covered += to - from + 1;
+            }
+        }
+        return covered;
+    }
+
+    // one entry per 256 code points of the BMP, most pages are uniform and
+    // answer without a search
+    struct PageTable
+    {
+        quint8 kinds[256] {};
+
+        constexpr PageTable()
+        {
+            for (uint page = 0; page < 256; ++page)
+            {
+                const uint wide = coveredInPage(l_wideRanges, page);
+                const uint zero = coveredInPage(l_zeroWidthRanges, page);
+                kinds[page] = wide == 256 ? WidePage
+                            : zero == 256 ? ZeroWidthPage
+                            : wide == 0 && zero == 0 ? NarrowPage
+                            : MixedPage;
+            }
+        }
+    };
+
+    constexpr PageTable l_pages;
+    static_assert(l_pages.kinds[0x00] == NarrowPage, "Latin-1 is narrow");
+    static_assert(l_pages.kinds[0x4E] == WidePage, "CJK ideographs are wide");
+    static_assert(l_pages.kinds[0x03] == MixedPage, "combining marks share a page with Greek");
+
+    template <int N>
+    bool contains(const Range (&ranges)[N], uint c)
+    {
+        int low = 0;
+        int high = N - 1;
+        while (low <= high)
+        {
+            const int middle = (low + high) / 2;
+            if (c < ranges[middle].first)
+            {
+                high = middle - 1;
+            }
+            else if (c > ranges[middle].last)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline int nextTabStop(int column, int tabSize)
+    {
+        return (column / tabSize + 1) * tabSize;
+    }
+
+    // advances over one character, surrogate pairs take two code units
+    inline int advance(const QString& text, int& i, int column, int tabSize)
+    {
+        const QChar c = text.at(i++);
+        if (c == QLatin1Char('\t'))
+        {
+            return nextTabStop(column, tabSize);
+        }
+        uint ucs4 = c.unicode();
+        if (c.isHighSurrogate() && i < text.size() && text.at(i).isLowSurrogate())
+        {
+            ucs4 = QChar::surrogateToUcs4(c, text.at(i++));
+        }
+        return column + CoolScrollTextColumns::charColumns(ucs4);
+    }
+}
+
+CoolScrollTextColumns::Kind CoolScrollTextColumns::classify(const QChar* data, int size)
+{
+    const ushort* units = reinterpret_cast<const ushort*>(data);
+    bool tabs = false;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i nonAsciiBits = _mm_set1_epi16(short(0xFF80));
+    const __m128i tab = _mm_set1_epi16(short('\t'));
+    __m128i tabLanes = zero;
+    for (; i + 8 <= size; i += 8)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i));
+        const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, nonAsciiBits), zero);
+        if (_mm_movemask_epi8(ascii) != 0xFFFF)
+        {
+            return Unicode;
+        }
+        tabLanes = _mm_or_si128(tabLanes, _mm_cmpeq_epi16(v, tab));
+    }
+    tabs = _mm_movemask_epi8(tabLanes) != 0;
+#endif
+    for (; i < size; ++i)
+    {
+        if (units[i] > 0x7F) return Unicode;
+        tabs = tabs || units[i] == '\t';
+    }
+    return tabs ? AsciiTabs : Ascii;
+}
+
+int CoolScrollTextColumns::charColumns(uint ucs4)
+{
+    if (ucs4 < 0x300) return 1;
+
+    if (ucs4 <= 0xFFFF)
+    {
+        switch (l_pages.kinds[ucs4 >> 8])
+        {
+        case NarrowPage:
+            return 1;
+        case WidePage:
+            return 2;
+        case ZeroWidthPage:
+            return 0;
+        default:
+            break;
+        }
+    }
+    if (contains(l_zeroWidthRanges, ucs4)) return 0;
+    return contains(l_wideRanges, ucs4) ? 2 : 1;
+}
+
+int CoolScrollTextColumns::columnOf(const QString& text, int index, Kind kind, int tabSize)
+{
+    if (kind == Ascii) return index;
+
+    tabSize = qMax(1, tabSize);
+    int column = 0;
+    for (int i = 0; i < index && i < text.size(); )
+    {
+        column = advance(text, i, column, tabSize);
+    }
+    return column;
+}
+
+int CoolScrollTextColumns::indexAt(const QString& text, int columns, Kind kind, int tabSize)
+{
+    if (kind == Ascii) return qBound(0, columns, text.size());
+
+    // stops at the first character which does not fit, only the prefix is looked at
+    tabSize = qMax(1, tabSize);
+    int column = 0;
+    int i = 0;
+    while (i < text.size())
+    {
+        int next = i;
+        const int nextColumn = advance(text, next, column, tabSize);
+        if (nextColumn > columns) break;
+        column = nextColumn;
+        i = next;
+    }
+    return i;
+}
+
+void CoolScrollTextColumns::columnStarts(const QString& text, Kind kind, int tabSize, QVector<int>& starts)
+{
+    starts.clear();
+    if (kind == Ascii) return;
+
+    tabSize = qMax(1, tabSize);
+    starts.resize(text.size() + 1);
+    int column = 0;
+    for (int i = 0; i < text.size(); )
+    {
+        const int from = i;
+        const int nextColumn = advance(text, i, column, tabSize);
+        for (int j = from; j < i; ++j)
+        {
+            starts[j] = column;
+        }
+        column = nextColumn;
+    }
+    starts[text.size()] = column;
+}
+
+QString CoolScrollTextColumns::expandTabs(const QString& text, int tabSize)
+{
+    if (!text.contains(QLatin1Char('\t'))) return text;
+
+    tabSize = qMax(1, tabSize);
+    QString result;
+    result.reserve(text.size() + tabSize);
+    int column = 0;
+    for (int i = 0; i < text.size(); )
+    {
+        const QChar c = text.at(i);
+        const int from = i;
+        const int nextColumn = advance(text, i, column, tabSize);
+        if (c == QLatin1Char('\t'))
+        {
+            result.append(QString(nextColumn - column, QLatin1Char(' ')));
+        }
+        else
+        {
+            result.append(text.constData() + from, i - from);
+        }
+        column = nextColumn;
+    }
+    return result;
+}
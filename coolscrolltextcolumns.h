@@ -0,0 +1,73 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLTEXTCOLUMNS_H
+#define COOLSCROLLTEXTCOLUMNS_H
+
+#include <QString>
+#include <QVector>
+
+// Display columns of text as a monospace editor shows it: a tab runs to the
+// next tab stop, East Asian wide characters take two columns and combining
+// marks none. Pure ASCII text, most of any source file, maps columns to
+// indexes without looking at the characters.
+class CoolScrollTextColumns
+{
+public:
+    enum Kind
+    {
+        Ascii,     // column == index
+        AsciiTabs, // ASCII with tabs
+        Unicode
+    };
+
+    // a single pass, eight UTF-16 code units at a time with SSE2
+    static Kind classify(const QChar* data, int size);
+    static inline Kind classify(const QString& text) { return classify(text.constData(), text.size()); }
+
+    // 0, 1 or 2 columns of a code point which is not a tab
+    static int charColumns(uint ucs4);
+
+    // column the character at index starts at, index may be the text size
+    static int columnOf(const QString& text, int index, Kind kind, int tabSize);
+    static inline int columns(const QString& text, Kind kind, int tabSize)
+    {
+        return columnOf(text, text.size(), kind, tabSize);
+    }
+    // number of leading code units which fit into the columns
+    static int indexAt(const QString& text, int columns, Kind kind, int tabSize);
+
+    // start column of every code unit, plus the end column; empty for ASCII
+    static void columnStarts(const QString& text, Kind kind, int tabSize, QVector<int>& starts);
+    // tabs replaced by spaces up to the next tab stop
+    static QString expandTabs(const QString& text, int tabSize);
+};
+
+#endif // COOLSCROLLTEXTCOLUMNS_H
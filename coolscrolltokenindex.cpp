@@ -0,0 +1,464 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "coolscrolltokenindex.h"
+
+#include "coolscrolldocumentsnapshot.h"
+
+
+#include <algorithm>
+
+namespace
+{
+    // blocks per chunk of the index; an edit adding or removing blocks
+    // re-lists the occurrences of the chunks it touches
+    const int l_chunkBlocks = 256;
+    // the id table is compacted when it grew by this many ids and by as many as were live
+    const int l_minDeadTokens = 1024;
+
+    inline quint64 entryOf(int key, int offset)
+    {
+        return (quint64(quint32(key)) << 32) | quint32(offset);
+    }
+
+    CoolScrollTokenTable buildTokenTable(const CoolScrollDocumentSnapshot& snapshot)
+    {
+        const QVector<QString> blocks = snapshot.texts();
+        CoolScrollTokenTable table;
+        table.blocks.resize(blocks.size());
+        for (int i = 0; i < blocks.size(); ++i)
+        {
+            table.tokenizeBlock(blocks[i], table.blocks[i]);
+        }
+        return table;
+    }
+}
+
+int CoolScrollTokenTable::tokenId(const QString& token)
+{
+    auto it = ids.constFind(token);
+    if (it != ids.constEnd())
+    {
+        return it.value();
+    }
+    const int id = tokens.size();
+    ids.insert(token, id);
+    tokens.push_back(token);
+    return id;
+}
+
+void CoolScrollTokenTable::tokenizeBlock(const QString& text, QVector<CoolScrollToken>& out)
+{
+    out.clear();
+    const ushort* data = text.utf16();
+    const int size = text.size();
+    int i = 0;
+    while (i < size)
+    {
+        if (!isIdentifierPart(data[i]))
+        {
+            ++i;
+            continue;
+        }
+        const int start = i;
+        while (i < size && isIdentifierPart(data[i]))
+        {
+            ++i;
+        }
+        // skip numbers like 0x1f
+        if (isIdentifierStart(data[start]))
+        {
+            out.push_back(CoolScrollToken { tokenId(text.mid(start, i - start)), start });
+        }
+    }
+}
+
+CoolScrollTokenIndex::CoolScrollTokenIndex(CoolScrollSnapshotTracker* snapshots, CoolScrollScheduler* scheduler,
+                                           QObject* parent) :
+    QObject(parent),
+    m_snapshots(snapshots),
+    m_scheduler(scheduler),
+    m_priority(CoolScrollScheduler::BackgroundEditor),
+    m_enabled(false),
+    m_ready(false),
+    m_structureChangedDuringBuild(false),
+    m_liveTokens(0),
+    m_nextChunkKey(0),
+    m_listsDirty(true)
+{
+    connect(&m_buildWatcher, &QFutureWatcher<CoolScrollTokenTable>::finished,
+                       this, &CoolScrollTokenIndex::buildFinished);
+}
+
+CoolScrollTokenIndex::~CoolScrollTokenIndex()
+{
+    m_scheduler->cancelAll(this);
+}
+
+void CoolScrollTokenIndex::setEnabled(bool enabled)
+{
+    if (enabled == m_enabled) return;
+
+    m_enabled = enabled;
+    if (m_enabled)
+    {
+        connect(m_snapshots, &CoolScrollSnapshotTracker::blocksReplaced,
+                       this, &CoolScrollTokenIndex::blocksReplaced);
+        startBuild();
+    }
+    else
+    {
+        disconnect(m_snapshots, &CoolScrollSnapshotTracker::blocksReplaced,
+                          this, &CoolScrollTokenIndex::blocksReplaced);
+        m_ready = false;
+        m_table = CoolScrollTokenTable();
+        setBlocks(QVector<QVector<CoolScrollToken>>());
+        m_tokenBlocks.clear();
+        m_listsDirty = true;
+    }
+}
+
+bool CoolScrollTokenIndex::isIdentifier(const QString& text)
+{
+    if (text.isEmpty() || !CoolScrollTokenTable::isIdentifierStart(text.at(0).unicode()))
+    {
+        return false;
+    }
+    return std::all_of(text.constBegin(), text.constEnd(),
+                       [](const QChar c) { return CoolScrollTokenTable::isIdentifierPart(c.unicode()); });
+}
+
+void CoolScrollTokenIndex::startBuild()
+{
+    m_ready = false;
+    m_structureChangedDuringBuild = false;
+    m_pendingBlocks.clear();
+
+    // the worker tokenizes a snapshot, no text is copied here;
+    // a build of older text still waiting for a worker is dropped
+    const CoolScrollDocumentSnapshot snapshot = m_snapshots->snapshot();
+    m_scheduler->cancelStale(this, snapshot.revision());
+    m_buildWatcher.setFuture(m_scheduler->run(m_priority, this, snapshot.revision(),
+                                              [snapshot]() { return buildTokenTable(snapshot); }));
+}
+
+void CoolScrollTokenIndex::buildFinished()
+{
+    if (!m_enabled || m_buildWatcher.isCanceled()) return;
+
+    if (m_structureChangedDuringBuild)
+    {
+        startBuild();
+        return;
+    }
+
+    m_table = m_buildWatcher.result();
+    m_liveTokens = m_table.tokens.size();
+    setBlocks(m_table.blocks);
+    m_table.blocks.clear();
+    m_listsDirty = true;
+    // blocks typed in while the worker was busy
+    for (int block : m_pendingBlocks)
+    {
+        retokenizeBlocks(block, block, block);
+    }
+    m_pendingBlocks.clear();
+
+    m_ready = true;
+    emit indexReady();
+}
+
+void CoolScrollTokenIndex::blocksReplaced(int first, int removed, int added)
+{
+    if (!m_ready)
+    {
+        if (removed != added)
+        {
+            m_structureChangedDuringBuild = true;
+            return;
+        }
+        for (int block = first; block < first + added; ++block)
+        {
+            m_pendingBlocks.insert(block);
+        }
+        return;
+    }
+
+    const int lastOld = first + removed - 1;
+    if (lastOld >= blockCount())
+    {
+        // should not happen, but do not trust a broken index
+        startBuild();
+        return;
+    }
+    retokenizeBlocks(first, lastOld, first + added - 1);
+    if (m_table.tokens.size() > 2 * m_liveTokens + l_minDeadTokens)
+    {
+        compactTable();
+    }
+}
+
+void CoolScrollTokenIndex::setBlocks(const QVector<QVector<CoolScrollToken>>& blocks)
+{
+    m_chunks.clear();
+    m_chunkOrder.clear();
+    for (int first = 0; first < blocks.size(); first += l_chunkBlocks)
+    {
+        const int key = m_nextChunkKey++;
+        m_chunks.insert(key, blocks.mid(first, l_chunkBlocks));
+        m_chunkOrder.push_back(key);
+    }
+    updateChunkStarts(0);
+}
+
+const CoolScrollTokenIndex::Chunk& CoolScrollTokenIndex::chunk(int key) const
+{
+    return m_chunks.constFind(key).value();
+}
+
+int CoolScrollTokenIndex::blockCount() const
+{
+    return m_chunkOrder.isEmpty() ? 0 : m_chunkStarts.last() + chunk(m_chunkOrder.last()).size();
+}
+
+int CoolScrollTokenIndex::chunkAt(int block) const
+{
+    const auto it = std::upper_bound(m_chunkStarts.constBegin(), m_chunkStarts.constEnd(), block);
+    return qMax(0, int(it - m_chunkStarts.constBegin()) - 1);
+}
+
+void CoolScrollTokenIndex::updateChunkStarts(int fromChunk)
+{
+    m_chunkStarts.resize(m_chunkOrder.size());
+    int start = fromChunk > 0 ? m_chunkStarts[fromChunk - 1] + chunk(m_chunkOrder[fromChunk - 1]).size() : 0;
+    for (int i = fromChunk; i < m_chunkOrder.size(); ++i)
+    {
+        m_chunkStarts[i] = start;
+        m_chunkStartByKey.insert(m_chunkOrder[i], start);
+        start += chunk(m_chunkOrder[i]).size();
+    }
+}
+
+void CoolScrollTokenIndex::retokenizeBlocks(int first, int lastOld, int lastNew)
+{
+    const CoolScrollDocumentSnapshot snapshot = m_snapshots->snapshot();
+    QVector<QVector<CoolScrollToken>> newBlocks(lastNew - first + 1);
+    for (int i = 0; i < newBlocks.size() && first + i < snapshot.blockCount(); ++i)
+    {
+        m_table.tokenizeBlock(snapshot.text(first + i), newBlocks[i]);
+    }
+
+    if (lastOld != lastNew)
+    {
+        replaceChunks(first, lastOld, newBlocks);
+        return;
+    }
+
+    // typing keeps block numbers, only the edited blocks are re-listed
+    for (int i = 0; i < newBlocks.size(); ++i)
+    {
+        const int position = chunkAt(first + i);
+        const int key = m_chunkOrder[position];
+        const int offset = first + i - m_chunkStarts[position];
+        if (!m_listsDirty) removeBlockFromLists(key, offset);
+        m_chunks[key][offset] = newBlocks[i];
+        if (!m_listsDirty) addBlockToLists(key, offset);
+    }
+}
+
+void CoolScrollTokenIndex::replaceChunks(int first, int lastOld, const QVector<QVector<CoolScrollToken>>& newBlocks)
+{
+    // the chunks touched by the edit are taken apart and cut again,
+    // chunks after them only get a new start
+    int firstChunk = m_chunkOrder.size();
+    int lastChunk = firstChunk - 1;
+    const int count = blockCount();
+    if (count > 0)
+    {
+        firstChunk = chunkAt(qMin(first, count - 1));
+        lastChunk = lastOld >= first ? chunkAt(lastOld) : firstChunk;
+    }
+    const int base = firstChunk < m_chunkOrder.size() ? m_chunkStarts[firstChunk] : count;
+
+    QVector<QVector<CoolScrollToken>> touched;
+    for (int i = firstChunk; i <= lastChunk; ++i)
+    {
+        const int key = m_chunkOrder[i];
+        if (!m_listsDirty)
+        {
+            for (int offset = 0; offset < chunk(key).size(); ++offset)
+            {
+                removeBlockFromLists(key, offset);
+            }
+        }
+        touched += m_chunks.take(key);
+        m_chunkStartByKey.remove(key);
+    }
+    const int removed = lastOld - first + 1;
+    QVector<QVector<CoolScrollToken>> blocks = touched.mid(0, first - base);
+    blocks += newBlocks;
+    blocks += touched.mid(first - base + removed);
+
+    QVector<int> keys;
+    for (int from = 0; from < blocks.size(); from += l_chunkBlocks)
+    {
+        const int key = m_nextChunkKey++;
+        m_chunks.insert(key, blocks.mid(from, l_chunkBlocks));
+        keys.push_back(key);
+    }
+    m_chunkOrder.erase(m_chunkOrder.begin() + firstChunk, m_chunkOrder.begin() + lastChunk + 1);
+    for (int i = 0; i < keys.size(); ++i)
+    {
+        m_chunkOrder.insert(firstChunk + i, keys[i]);
+    }
+    updateChunkStarts(firstChunk);
+
+    if (!m_listsDirty)
+    {
+        for (int key : keys)
+        {
+            for (int offset = 0; offset < chunk(key).size(); ++offset)
+            {
+                addBlockToLists(key, offset);
+            }
+        }
+    }
+}
+
+void CoolScrollTokenIndex::compactTable()
+{
+    // ids still found in some block are numbered again in the order met,
+    // the lists are built from the renumbered chunks when next needed
+    QVector<int> newIds(m_table.tokens.size(), -1);
+    CoolScrollTokenTable table;
+    for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+    {
+        for (QVector<CoolScrollToken>& block : it.value())
+        {
+            for (CoolScrollToken& token : block)
+            {
+                int& id = newIds[token.id];
+                if (id < 0)
+                {
+                    id = table.tokenId(m_table.tokens[token.id]);
+                }
+                token.id = id;
+            }
+        }
+    }
+    m_table.ids.swap(table.ids);
+    m_table.tokens.swap(table.tokens);
+    m_liveTokens = m_table.tokens.size();
+    m_tokenBlocks.clear();
+    m_listsDirty = true;
+}
+
+void CoolScrollTokenIndex::rebuildInvertedLists() const
+{
+    // keys ascend in the map, so every list comes out sorted
+    m_tokenBlocks = QVector<QVector<quint64>>(m_table.tokens.size());
+    for (auto it = m_chunks.constBegin(); it != m_chunks.constEnd(); ++it)
+    {
+        for (int offset = 0; offset < it.value().size(); ++offset)
+        {
+            const quint64 entry = entryOf(it.key(), offset);
+            for (const CoolScrollToken& token : it.value()[offset])
+            {
+                QVector<quint64>& list = m_tokenBlocks[token.id];
+                if (list.isEmpty() || list.last() != entry)
+                {
+                    list.push_back(entry);
+                }
+            }
+        }
+    }
+    m_listsDirty = false;
+}
+
+void CoolScrollTokenIndex::addBlockToLists(int key, int offset) const
+{
+    if (m_tokenBlocks.size() < m_table.tokens.size())
+    {
+        m_tokenBlocks.resize(m_table.tokens.size());
+    }
+    const quint64 entry = entryOf(key, offset);
+    for (const CoolScrollToken& token : chunk(key)[offset])
+    {
+        QVector<quint64>& list = m_tokenBlocks[token.id];
+        auto pos = std::lower_bound(list.begin(), list.end(), entry);
+        if (pos == list.end() || *pos != entry)
+        {
+            list.insert(pos, entry);
+        }
+    }
+}
+
+void CoolScrollTokenIndex::removeBlockFromLists(int key, int offset) const
+{
+    const quint64 entry = entryOf(key, offset);
+    for (const CoolScrollToken& token : chunk(key)[offset])
+    {
+        QVector<quint64>& list = m_tokenBlocks[token.id];
+        auto pos = std::lower_bound(list.begin(), list.end(), entry);
+        if (pos != list.end() && *pos == entry)
+        {
+            list.erase(pos);
+        }
+    }
+}
+
+void CoolScrollTokenIndex::occurrences(const QString& token, int term,
+                                       QVector<CoolScrollSearchMatch>& matches) const
+{
+    if (!m_ready) return;
+
+    auto it = m_table.ids.constFind(token);
+    if (it == m_table.ids.constEnd()) return;
+
+    if (m_listsDirty)
+    {
+        rebuildInvertedLists();
+    }
+    const int id = it.value();
+    if (id >= m_tokenBlocks.size()) return;
+
+    for (const quint64 entry : m_tokenBlocks[id])
+    {
+        const int key = int(entry >> 32);
+        const int offset = int(entry & 0xffffffff);
+        const int block = m_chunkStartByKey.value(key) + offset;
+        for (const CoolScrollToken& t : chunk(key)[offset])
+        {
+            if (t.id == id)
+            {
+                matches.push_back(CoolScrollSearchMatch { block, t.column, token.size(), term });
+            }
+        }
+    }
+}
@@ -0,0 +1,157 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef COOLSCROLLTOKENINDEX_H
+#define COOLSCROLLTOKENINDEX_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "coolscrollmultisearch.h"
+#include "coolscrollscheduler.h"
+
+class CoolScrollSnapshotTracker;
+
+struct CoolScrollToken
+{
+    int id;
+    int column;
+};
+
+// identifiers of a document: per block token lists plus an id table
+struct CoolScrollTokenTable
+{
+    QHash<QString, int> ids;
+    QVector<QString> tokens;
+    QVector<QVector<CoolScrollToken>> blocks;
+
+    int tokenId(const QString& token);
+    void tokenizeBlock(const QString& text, QVector<CoolScrollToken>& out);
+
+    // a token is a maximal run of identifier parts starting with an identifier start
+    static inline bool isIdentifierStart(ushort c)
+    {
+        if (c < 0x80)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        }
+        return QChar(c).isLetter();
+    }
+    static inline bool isIdentifierPart(ushort c)
+    {
+        if (c < 0x80)
+        {
+            return isIdentifierStart(c) || (c >= '0' && c <= '9');
+        }
+        return QChar(c).isLetterOrNumber();
+    }
+};
+
+// Inverted index from identifiers to blocks where they occur. The first build
+// runs on a worker thread, after that single blocks are re-tokenized on change.
+class CoolScrollTokenIndex : public QObject
+{
+    Q_OBJECT
+public:
+    CoolScrollTokenIndex(CoolScrollSnapshotTracker* snapshots, CoolScrollScheduler* scheduler,
+                         QObject* parent = nullptr);
+    ~CoolScrollTokenIndex();
+
+    void setEnabled(bool enabled);
+    // of builds started from now on, follows the state of the editor
+    inline void setPriority(CoolScrollScheduler::Priority priority) { m_priority = priority; }
+    inline bool isEnabled() const { return m_enabled; }
+    inline bool isReady() const { return m_ready; }
+
+    // appends whole-word occurrences of token, cost is proportional to their count
+    void occurrences(const QString& token, int term, QVector<CoolScrollSearchMatch>& matches) const;
+
+    static bool isIdentifier(const QString& text);
+
+signals:
+
+    void indexReady();
+
+private slots:
+
+    void blocksReplaced(int first, int removed, int added);
+    void buildFinished();
+
+private:
+
+    // Blocks are kept in chunks and lists refer to them by chunk key and
+    // position in the chunk, so an edit which adds or removes blocks only
+    // renumbers chunks; occurrences in other chunks stay as they are.
+    typedef QVector<QVector<CoolScrollToken>> Chunk;
+
+    void startBuild();
+    void setBlocks(const QVector<QVector<CoolScrollToken>>& blocks);
+    const Chunk& chunk(int key) const;
+    int blockCount() const;
+    int chunkAt(int block) const; // position in m_chunkOrder
+    void retokenizeBlocks(int first, int lastOld, int lastNew);
+    void replaceChunks(int first, int lastOld, const QVector<QVector<CoolScrollToken>>& newBlocks);
+    void updateChunkStarts(int fromChunk);
+    // drops ids no block refers to any more, e.g. prefixes of typed identifiers
+    void compactTable();
+    void rebuildInvertedLists() const;
+    void addBlockToLists(int key, int offset) const;
+    void removeBlockFromLists(int key, int offset) const;
+
+    CoolScrollSnapshotTracker* m_snapshots;
+    CoolScrollScheduler* m_scheduler;
+    CoolScrollScheduler::Priority m_priority;
+    bool m_enabled;
+    bool m_ready;
+
+    // edits made while the worker builds the index
+    bool m_structureChangedDuringBuild;
+    QSet<int> m_pendingBlocks;
+
+    CoolScrollTokenTable m_table; // its blocks are moved into chunks
+    int m_liveTokens;             // ids in the table after the last build or compaction
+    QMap<int, Chunk> m_chunks;     // by key, keys of new chunks grow
+    QVector<int> m_chunkOrder;     // keys in document order
+    QVector<int> m_chunkStarts;    // number of the first block of each chunk in that order
+    QHash<int, int> m_chunkStartByKey;
+    int m_nextChunkKey;
+    // token id -> sorted (chunk key << 32 | position) of blocks containing it,
+    // built lazily once after a build, then kept up to date per chunk
+    mutable QVector<QVector<quint64>> m_tokenBlocks;
+    mutable bool m_listsDirty;
+
+    QFutureWatcher<CoolScrollTokenTable> m_buildWatcher;
+};
+
+#endif // COOLSCROLLTOKENINDEX_H
@@ -0,0 +1,226 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#include "coolscrollwrapmodel.h"
+
+#include <algorithm>
+
+CoolScrollWrapModel::CoolScrollWrapModel() :
+    m_blockStarts(1, 0),
+    m_chunkRowStarts(1, 0),
+    m_wrapColumn(0),
+    m_tabSize(0),
+    m_revision(-1),
+    m_generation(0)
+{
+}
+
+bool CoolScrollWrapModel::update(const CoolScrollDocumentSnapshot& snapshot, int wrapColumn, int tabSize)
+{
+    if (snapshot.revision() == m_revision && wrapColumn == m_wrapColumn && tabSize == m_tabSize) return false;
+
+    // an edit copies the chunks it touches and keeps the others, these are
+    // found at both ends and keep their rows
+    const bool geometryKept = wrapColumn == m_wrapColumn && tabSize == m_tabSize;
+    m_wrapColumn = wrapColumn;
+    m_tabSize = tabSize;
+    const QVector<QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>>& chunks = snapshot.m_chunks;
+    int head = 0;
+    int tail = 0;
+    if (geometryKept)
+    {
+        const int shared = qMin(chunks.size(), m_chunks.size());
+        while (head < shared && chunks[head] == m_chunks[head].chunk)
+        {
+            ++head;
+        }
+        while (tail < shared - head && chunks[chunks.size() - 1 - tail] == m_chunks[m_chunks.size() - 1 - tail].chunk)
+        {
+            ++tail;
+        }
+    }
+
+    QVector<ChunkRows> counted;
+    counted.reserve(chunks.size());
+    counted += m_chunks.mid(0, head);
+    for (int i = head; i < chunks.size() - tail; ++i)
+    {
+        counted.push_back(countRows(chunks[i]));
+    }
+    counted += m_chunks.mid(m_chunks.size() - tail);
+    m_chunks.swap(counted);
+
+    // one entry per chunk, a few thousand even for the largest documents
+    m_blockStarts.resize(m_chunks.size() + 1);
+    m_chunkRowStarts.resize(m_chunks.size() + 1);
+    int block = 0;
+    int row = 0;
+    for (int i = 0; i < m_chunks.size(); ++i)
+    {
+        m_blockStarts[i] = block;
+        m_chunkRowStarts[i] = row;
+        block += m_chunks[i].chunk->size();
+        row += m_chunks[i].rowStarts.last();
+    }
+    m_blockStarts.last() = block;
+    m_chunkRowStarts.last() = row;
+
+    m_revision = snapshot.revision();
+    ++m_generation;
+    return true;
+}
+
+CoolScrollWrapModel::ChunkRows CoolScrollWrapModel::countRows(
+        const QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>& chunk) const
+{
+    ChunkRows result;
+    result.chunk = chunk;
+    result.rowStarts.reserve(chunk->size() + 1);
+    int row = 0;
+    for (const CoolScrollDocumentSnapshot::Block& block : *chunk)
+    {
+        result.rowStarts.push_back(row);
+        if (block.visible)
+        {
+            // ASCII blocks, nearly all of them, are counted by length alone;
+            // without wrapping a visible block is one row
+            const int columns = m_wrapColumn > 0
+                    ? CoolScrollTextColumns::columns(block.text, block.kind, m_tabSize) : 0;
+            row += rowsOf(columns, m_wrapColumn);
+        }
+    }
+    result.rowStarts.push_back(row);
+    return result;
+}
+
+int CoolScrollWrapModel::chunkOf(int block) const
+{
+    const auto it = std::upper_bound(m_blockStarts.constBegin(), m_blockStarts.constEnd() - 1, block);
+    return qBound(0, int(it - m_blockStarts.constBegin()) - 1, m_chunks.size() - 1);
+}
+
+int CoolScrollWrapModel::firstRow(int block) const
+{
+    if (block <= 0 || m_chunks.isEmpty()) return 0;
+    if (block >= blockCount()) return rowCount();
+
+    const int chunk = chunkOf(block);
+    return m_chunkRowStarts[chunk] + m_chunks[chunk].rowStarts[block - m_blockStarts[chunk]];
+}
+
+int CoolScrollWrapModel::rows(int block) const
+{
+    if (block < 0 || block >= blockCount()) return 0;
+
+    const int chunk = chunkOf(block);
+    const QVector<int>& rowStarts = m_chunks[chunk].rowStarts;
+    const int i = block - m_blockStarts[chunk];
+    return rowStarts[i + 1] - rowStarts[i];
+}
+
+int CoolScrollWrapModel::rowOfColumn(int block, int column) const
+{
+    const int offset = m_wrapColumn > 0 ? column / m_wrapColumn : 0;
+    return firstRow(block) + qBound(0, offset, qMax(0, rows(block) - 1));
+}
+
+int CoolScrollWrapModel::blockAt(int row) const
+{
+    if (blockCount() == 0) return 0;
+
+    // folded blocks share the start of the next one, the last of equal starts is
+    // drawn; it is in the last chunk starting at or above the row
+    const auto chunkIt = std::upper_bound(m_chunkRowStarts.constBegin(), m_chunkRowStarts.constEnd() - 1, row);
+    const int chunk = qBound(0, int(chunkIt - m_chunkRowStarts.constBegin()) - 1, m_chunks.size() - 1);
+    const QVector<int>& rowStarts = m_chunks[chunk].rowStarts;
+    const auto it = std::upper_bound(rowStarts.constBegin(), rowStarts.constEnd() - 1,
+                                     row - m_chunkRowStarts[chunk]);
+    const int block = m_blockStarts[chunk] + int(it - rowStarts.constBegin()) - 1;
+    return qBound(0, block, blockCount() - 1);
+}
+
+QVector<QString> CoolScrollWrapModel::rowTexts(const CoolScrollDocumentSnapshot& snapshot, int maxCount,
+                                               QVector<quint8>* kinds) const
+{
+    return rowTextsFrom(snapshot, 0, maxCount, kinds);
+}
+
+QVector<QString> CoolScrollWrapModel::rowTextsFrom(const CoolScrollDocumentSnapshot& snapshot, int fromRow,
+                                                   int maxCount, QVector<quint8>* kinds) const
+{
+    QVector<QString> result;
+    if (kinds)
+    {
+        kinds->clear();
+    }
+    if (fromRow >= rowCount()) return result;
+
+    result.reserve(qMin(maxCount, rowCount() - fromRow));
+    if (kinds)
+    {
+        kinds->reserve(result.capacity());
+    }
+    // the first block may start above the first row, its upper rows are skipped
+    const int firstBlock = blockAt(fromRow);
+    int skip = fromRow - firstRow(firstBlock);
+    const int wrapColumn = m_wrapColumn;
+    const int tabSize = m_tabSize;
+    snapshot.forEachBlock([&result, &skip, kinds, maxCount, wrapColumn, tabSize](const QString& text, bool visible,
+                                                                                 CoolScrollTextColumns::Kind kind)
+    {
+        if (!visible) return true;
+
+        const int columns = wrapColumn > 0 ? CoolScrollTextColumns::columns(text, kind, tabSize) : 0;
+        const int rowsCount = rowsOf(columns, wrapColumn);
+        int start = skip > 0 ? CoolScrollTextColumns::indexAt(text, skip * wrapColumn, kind, tabSize) : 0;
+        for (int i = skip; i < rowsCount && result.size() < maxCount; ++i)
+        {
+            // the last row takes the rest, a wide character may not fit into the previous ones
+            const int end = i + 1 < rowsCount
+                    ? CoolScrollTextColumns::indexAt(text, (i + 1) * wrapColumn, kind, tabSize)
+                    : text.size();
+            result.push_back(rowsCount == 1 ? text : text.mid(start, end - start));
+            if (kinds)
+            {
+                kinds->push_back(kind);
+            }
+            start = end;
+        }
+        skip = 0;
+        return result.size() < maxCount;
+    }, firstBlock);
+    return result;
+}
+
+int CoolScrollWrapModel::rowsOf(int columns, int wrapColumn)
+{
+    if (wrapColumn <= 0 || columns <= wrapColumn) return 1;
+    return (columns + wrapColumn - 1) / wrapColumn;
+}
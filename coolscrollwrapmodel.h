@@ -0,0 +1,105 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+#ifndef COOLSCROLLWRAPMODEL_H
+#define COOLSCROLLWRAPMODEL_H
+
+#include <QString>
+#include <QVector>
+
+#include <limits>
+
+#include "coolscrolldocumentsnapshot.h"
+
+// Rows of the minimap when the editor wraps long lines. A block takes as many
+// rows as its display columns need at the wrap column; columns are counted
+// from the text alone, which is exact for monospace text and never lays
+// blocks out. Rows are counted per snapshot chunk, so an edit recounts only
+// the chunks it copied.
+class CoolScrollWrapModel
+{
+public:
+    CoolScrollWrapModel();
+
+    // recounts rows if the snapshot revision, the wrap column or the tab size
+    // differ from the previous call, returns true then; chunks shared with the
+    // previous snapshot keep their rows unless wrap column or tab size changed;
+    // wrap column 0 means no wrapping, one row per visible block
+    bool update(const CoolScrollDocumentSnapshot& snapshot, int wrapColumn, int tabSize);
+
+    inline int wrapColumn() const { return m_wrapColumn; }
+    inline int tabSize() const { return m_tabSize; }
+    // grows with every recount, layers cache their rows against it
+    inline int generation() const { return m_generation; }
+
+    inline int blockCount() const { return m_blockStarts.last(); }
+    inline int rowCount() const { return m_chunkRowStarts.last(); }
+
+    // first row of a block and the number of its rows, 0 when folded
+    int firstRow(int block) const;
+    int rows(int block) const;
+    // row of a display column, i.e. the wrapped line the column falls into
+    int rowOfColumn(int block, int column) const;
+    // block drawn at a row, rows past the end map to the last block
+    int blockAt(int row) const;
+
+    // one text per row from the top, wrapped blocks are cut at the wrap column;
+    // kinds, if given, receive the text kind of the block of each row
+    QVector<QString> rowTexts(const CoolScrollDocumentSnapshot& snapshot,
+                              int maxCount = std::numeric_limits<int>::max(),
+                              QVector<quint8>* kinds = nullptr) const;
+    // the same from a row on, blocks above it are not looked at
+    QVector<QString> rowTextsFrom(const CoolScrollDocumentSnapshot& snapshot, int fromRow,
+                                  int maxCount = std::numeric_limits<int>::max(),
+                                  QVector<quint8>* kinds = nullptr) const;
+
+    static int rowsOf(int columns, int wrapColumn);
+
+private:
+
+    struct ChunkRows
+    {
+        QSharedPointer<const CoolScrollDocumentSnapshot::Chunk> chunk; // the rows were counted for
+        QVector<int> rowStarts; // first row of each block within the chunk, its row count at the end
+    };
+
+    int chunkOf(int block) const;
+    ChunkRows countRows(const QSharedPointer<const CoolScrollDocumentSnapshot::Chunk>& chunk) const;
+
+    QVector<ChunkRows> m_chunks;
+    QVector<int> m_blockStarts;    // first block of each chunk, the block count at the end
+    QVector<int> m_chunkRowStarts; // first row of each chunk, the row count at the end
+    int m_wrapColumn;
+    int m_tabSize;
+    int m_revision;
+    int m_generation;
+};
+
+#endif // COOLSCROLLWRAPMODEL_H
@@ -39,6 +39,11 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
     ui->setupUi(this);
 
     ui->widthSpinBox->setRange(5, 400);
+    ui->frameBudgetSpinBox->setRange(1, 200);
+    ui->prewarmIdleSpinBox->setRange(0, 60000);
+    ui->prewarmIdleSpinBox->setSingleStep(250);
+    ui->memoryBudgetSpinBox->setRange(1, 4096);
+    ui->outlineGapSpinBox->setRange(0, 80);
 
 
     connect(ui->vieportColotButton, SIGNAL(clicked()),
@@ -47,8 +52,18 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
                                       SLOT(colorSettingsButtonClicked()));
 
     connect(ui->widthSpinBox, SIGNAL(valueChanged(int)), SLOT(settingsChanged()));
+    connect(ui->frameBudgetSpinBox, SIGNAL(valueChanged(int)), SLOT(settingsChanged()));
+    connect(ui->prewarmIdleSpinBox, SIGNAL(valueChanged(int)), SLOT(settingsChanged()));
+    connect(ui->memoryBudgetSpinBox, SIGNAL(valueChanged(int)), SLOT(settingsChanged()));
+    connect(ui->outlineGapSpinBox, SIGNAL(valueChanged(int)), SLOT(settingsChanged()));
 
     connect(ui->contextMenuCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
+    connect(ui->tokenIndexCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
+    connect(ui->wordUnderCursorCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
+    connect(ui->vcsChangesCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
+    connect(ui->diskCacheCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
+    connect(ui->hoverLensCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
+    connect(ui->scrollingMinimapCheckBox, SIGNAL(stateChanged(int)), SLOT(settingsChanged()));
 }
 
 SettingsDialog::~SettingsDialog()
@@ -63,6 +78,17 @@ void SettingsDialog::setSettings(const CoolScrollbarSettings &settings)
     setButtonColor(ui->selectionColorButton,settings.selectionHighlightColor);
 
     ui->contextMenuCheckBox->setChecked(!settings.disableContextMenu);
+    ui->tokenIndexCheckBox->setChecked(settings.tokenIndexEnabled);
+    ui->wordUnderCursorCheckBox->setChecked(settings.highlightWordUnderCursor);
+    ui->vcsChangesCheckBox->setChecked(settings.showVcsChanges);
+    ui->hoverLensCheckBox->setChecked(settings.showHoverLens);
+    ui->scrollingMinimapCheckBox->setChecked(settings.scrollingMinimap);
+    ui->diskCacheCheckBox->setChecked(settings.diskCacheEnabled);
+    ui->diskCacheCheckBox->setToolTip(settings.diskCacheDirectory);
+    ui->frameBudgetSpinBox->setValue(settings.frameBudget);
+    ui->prewarmIdleSpinBox->setValue(settings.prewarmIdle);
+    ui->memoryBudgetSpinBox->setValue(settings.memoryBudget);
+    ui->outlineGapSpinBox->setValue(settings.outlineGap);
 }
 
 void SettingsDialog::colorSettingsButtonClicked()
@@ -94,12 +120,32 @@ QColor SettingsDialog::getButtonColor(QPushButton *button)
     return button->palette().button().color();
 }
 
+void SettingsDialog::setMetricsReport(const QString& report)
+{
+    ui->metricsTextEdit->setPlainText(report);
+}
+
+void SettingsDialog::setRenderQuality(const QString& quality)
+{
+    ui->qualityLabel->setText(quality);
+}
+
 void SettingsDialog::getSettings(CoolScrollbarSettings &settings) const
 {
     settings.scrollBarWidth = ui->widthSpinBox->value();
     settings.viewportColor = getButtonColor(ui->vieportColotButton);
     settings.selectionHighlightColor = getButtonColor(ui->selectionColorButton);
     settings.disableContextMenu = !ui->contextMenuCheckBox->isChecked();
+    settings.tokenIndexEnabled = ui->tokenIndexCheckBox->isChecked();
+    settings.highlightWordUnderCursor = ui->wordUnderCursorCheckBox->isChecked();
+    settings.showVcsChanges = ui->vcsChangesCheckBox->isChecked();
+    settings.showHoverLens = ui->hoverLensCheckBox->isChecked();
+    settings.scrollingMinimap = ui->scrollingMinimapCheckBox->isChecked();
+    settings.diskCacheEnabled = ui->diskCacheCheckBox->isChecked();
+    settings.frameBudget = ui->frameBudgetSpinBox->value();
+    settings.prewarmIdle = ui->prewarmIdleSpinBox->value();
+    settings.memoryBudget = ui->memoryBudgetSpinBox->value();
+    settings.outlineGap = ui->outlineGapSpinBox->value();
 }
 
 void SettingsDialog::settingsChanged()
@@ -49,6 +49,8 @@ public:
 
     void setSettings(const CoolScrollbarSettings& settings);
     void getSettings(CoolScrollbarSettings& settings) const;
+    void setMetricsReport(const QString& report);
+    void setRenderQuality(const QString& quality);
 
     inline bool isSettingsChanged() const { return m_settingsChanged; }
 
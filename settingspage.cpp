@@ -30,13 +30,17 @@
 #include "settingspage.h"
 #include "settingsdialog.h"
 #include "coolscrollconstants.h"
+#include "coolscrollmetrics.h"
+#include "coolscrollqualitygovernor.h"
 #include <QCoreApplication>
 
 namespace CoolScroll {
 namespace Internal {
 
-SettingsPage::SettingsPage(QSharedPointer<CoolScrollbarSettings>& settings) :
-    m_settings(settings)
+SettingsPage::SettingsPage(QSharedPointer<CoolScrollbarSettings>& settings,
+                           QSharedPointer<CoolScrollMetrics>& metrics) :
+    m_settings(settings),
+    m_metrics(metrics)
 {
     setId(Constants::COOLSCROLL_SETTINGS_ID);
     setCategory(Constants::COOLSCROLL_SETTINGS_CATEGORY);
@@ -53,7 +57,9 @@ void SettingsPage::apply()
 {
     if(m_dialog->isSettingsChanged())
     {
+        const CoolScrollbarSettings previous = *m_settings;
         m_dialog->getSettings(*m_settings);
+        m_settings->updateGenerations(previous);
         emit settingsChanged();
     }
 }
@@ -67,6 +73,12 @@ QWidget * SettingsPage::widget()
 {
     m_dialog = new SettingsDialog();
     m_dialog->setSettings(*m_settings);
+    m_dialog->setMetricsReport(m_metrics->report());
+    // reported by the scroll bar which rendered last, i.e. the current editor
+    const QString detail = CoolScrollQualityGovernor::detailName(
+                CoolScrollRenderer::Detail(m_metrics->value(QStringLiteral("quality.detail"))));
+    m_dialog->setRenderQuality(tr("%1, last render %2 ms").arg(detail)
+                               .arg(m_metrics->value(QStringLiteral("quality.last_usec")) / 1000.0, 0, 'f', 1));
     return m_dialog;
 }
 
@@ -35,6 +35,7 @@
 #include <coreplugin/dialogs/ioptionspage.h>
 #include "coolscrollbarsettings.h"
 
+class CoolScrollMetrics;
 class SettingsDialog;
 
 namespace CoolScroll {
@@ -44,7 +45,8 @@ class SettingsPage : public Core::IOptionsPage
 {
     Q_OBJECT
 public:
-    SettingsPage(QSharedPointer<CoolScrollbarSettings>& settings);
+    SettingsPage(QSharedPointer<CoolScrollbarSettings>& settings,
+                 QSharedPointer<CoolScrollMetrics>& metrics);
     ~SettingsPage();
 
     QWidget *widget();
@@ -54,6 +56,7 @@ public:
 private:
 
     QSharedPointer<CoolScrollbarSettings> m_settings;
+    QSharedPointer<CoolScrollMetrics> m_metrics;
 
     SettingsDialog* m_dialog;
 
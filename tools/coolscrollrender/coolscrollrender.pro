@@ -0,0 +1,43 @@
+# Renders a source file the way the CoolScroll bar does, without Qt Creator.
+# Run with -platform offscreen (or QT_QPA_PLATFORM=offscreen) on machines
+# without a display.
+
+TEMPLATE = app
+TARGET = coolscrollrender
+
+QT += gui concurrent
+CONFIG += console
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++14
+
+PLUGIN_SOURCE_TREE = $$PWD/../..
+INCLUDEPATH += $$PLUGIN_SOURCE_TREE
+
+SOURCES += main.cpp \
+    replay.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrollrenderer.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrolldiff.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrolldocumentsnapshot.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrollwrapmodel.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrolltextcolumns.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrolloutline.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrollmetrics.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrollscheduler.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrolltokenindex.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrollmultisearch.cpp \
+    $$PLUGIN_SOURCE_TREE/coolscrollhighlightcoverage.cpp
+
+HEADERS += \
+    replay.h \
+    $$PLUGIN_SOURCE_TREE/coolscrollrenderer.h \
+    $$PLUGIN_SOURCE_TREE/coolscrolldiff.h \
+    $$PLUGIN_SOURCE_TREE/coolscrolldocumentsnapshot.h \
+    $$PLUGIN_SOURCE_TREE/coolscrollwrapmodel.h \
+    $$PLUGIN_SOURCE_TREE/coolscrolltextcolumns.h \
+    $$PLUGIN_SOURCE_TREE/coolscrolloutline.h \
+    $$PLUGIN_SOURCE_TREE/coolscrollmetrics.h \
+    $$PLUGIN_SOURCE_TREE/coolscrollscheduler.h \
+    $$PLUGIN_SOURCE_TREE/coolscrolltokenindex.h \
+    $$PLUGIN_SOURCE_TREE/coolscrollmultisearch.h \
+    $$PLUGIN_SOURCE_TREE/coolscrollhighlightcoverage.h
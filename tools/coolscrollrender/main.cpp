@@ -0,0 +1,325 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+
+// Loads a source file into a QTextDocument and renders it with the
+// CoolScroll renderer, e.g.
+//
+//   coolscrollrender -platform offscreen --width 120 --height 2160 \
+//       --output minimap.png --golden golden/minimap.png file.cpp
+//
+// Timings and memory are printed in the format of the plugin metrics report.
+// The exit code is 1 when a golden image differs, 2 on usage errors.
+//
+// With --replay or --generate an edit session is applied to the file instead
+// and the incremental minimap is checked against a fresh one (see replay.h);
+// the exit code is 1 when they differ.
+//
+// With --diff the file is diffed against a baseline file as the change bars
+// are, --repeat times, and the diff times are printed.
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QTextDocument>
+#include <QTextStream>
+
+#include "coolscrolldiff.h"
+#include "coolscrolldocumentsnapshot.h"
+#include "coolscrollmetrics.h"
+#include "coolscrollrenderer.h"
+#include "coolscrollwrapmodel.h"
+#include "replay.h"
+
+namespace
+{
+    const char* const l_detailNames[] = { "text", "glyph", "block", "density", "outline" };
+    static_assert(sizeof(l_detailNames) / sizeof(l_detailNames[0]) == CoolScrollRenderer::DetailCount,
+                  "every detail needs a name");
+
+    int detailFromName(const QString& name)
+    {
+        for (int detail = 0; detail < CoolScrollRenderer::DetailCount; ++detail)
+        {
+            if (name == QLatin1String(l_detailNames[detail])) return detail;
+        }
+        return -1;
+    }
+
+    // number of pixels which differ in any channel by more than the tolerance
+    qint64 differentPixels(const QImage& rendered, const QImage& golden, int tolerance)
+    {
+        const QImage a = rendered.convertToFormat(QImage::Format_ARGB32);
+        const QImage b = golden.convertToFormat(QImage::Format_ARGB32);
+        qint64 count = 0;
+        for (int y = 0; y < a.height(); ++y)
+        {
+            const QRgb* lineA = reinterpret_cast<const QRgb*>(a.constScanLine(y));
+            const QRgb* lineB = reinterpret_cast<const QRgb*>(b.constScanLine(y));
+            for (int x = 0; x < a.width(); ++x)
+            {
+                if (qAbs(qRed(lineA[x]) - qRed(lineB[x])) > tolerance ||
+                    qAbs(qGreen(lineA[x]) - qGreen(lineB[x])) > tolerance ||
+                    qAbs(qBlue(lineA[x]) - qBlue(lineB[x])) > tolerance ||
+                    qAbs(qAlpha(lineA[x]) - qAlpha(lineB[x])) > tolerance)
+                {
+                    ++count;
+                }
+            }
+        }
+        return count;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("coolscrollrender"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Renders a source file into a CoolScroll minimap image."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Source file to render."));
+    const QCommandLineOption widthOption(QStringLiteral("width"), QStringLiteral("Scroll bar width in logical pixels."),
+                                         QStringLiteral("pixels"), QStringLiteral("120"));
+    const QCommandLineOption heightOption(QStringLiteral("height"), QStringLiteral("Scroll bar height in logical pixels."),
+                                          QStringLiteral("pixels"), QStringLiteral("1080"));
+    const QCommandLineOption dprOption(QStringLiteral("dpr"), QStringLiteral("Device pixel ratio."),
+                                       QStringLiteral("ratio"), QStringLiteral("1"));
+    const QCommandLineOption detailOption(QStringLiteral("detail"),
+                                          QStringLiteral("Richest detail allowed: text, glyph, block, density or outline."),
+                                          QStringLiteral("detail"), QStringLiteral("text"));
+    const QCommandLineOption wrapOption(QStringLiteral("wrap-column"),
+                                        QStringLiteral("Wrap lines at this column, 0 for no wrapping."),
+                                        QStringLiteral("column"), QStringLiteral("0"));
+    const QCommandLineOption tabOption(QStringLiteral("tab-size"), QStringLiteral("Columns per tab stop."),
+                                       QStringLiteral("columns"), QStringLiteral("4"));
+    const QCommandLineOption outlineGapOption(QStringLiteral("outline-gap"),
+                                              QStringLiteral("Whitespace columns splitting outline bars, 0 never splits."),
+                                              QStringLiteral("columns"), QStringLiteral("8"));
+    const QCommandLineOption repeatOption(QStringLiteral("repeat"),
+                                          QStringLiteral("Render this many times for timing."),
+                                          QStringLiteral("count"), QStringLiteral("1"));
+    const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Write the image as PNG."),
+                                          QStringLiteral("png"));
+    const QCommandLineOption goldenOption(QStringLiteral("golden"),
+                                          QStringLiteral("Compare with a golden PNG, write it if it does not exist."),
+                                          QStringLiteral("png"));
+    const QCommandLineOption toleranceOption(QStringLiteral("tolerance"),
+                                             QStringLiteral("Channel difference still matching the golden image."),
+                                             QStringLiteral("value"), QStringLiteral("0"));
+    const QCommandLineOption replayOption(QStringLiteral("replay"),
+                                          QStringLiteral("Replay an edit script and check every step."),
+                                          QStringLiteral("script"));
+    const QCommandLineOption generateOption(QStringLiteral("generate"),
+                                            QStringLiteral("Replay a random edit session of this many steps."),
+                                            QStringLiteral("steps"));
+    const QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed of the random edit session."),
+                                        QStringLiteral("number"), QStringLiteral("1"));
+    const QCommandLineOption saveScriptOption(QStringLiteral("save-script"),
+                                              QStringLiteral("Write the replayed steps as an edit script."),
+                                              QStringLiteral("script"));
+    const QCommandLineOption checkEveryOption(QStringLiteral("check-every"),
+                                              QStringLiteral("Compare with a fresh computation after every n-th step."),
+                                              QStringLiteral("steps"), QStringLiteral("1"));
+    const QCommandLineOption termOption(QStringLiteral("term"),
+                                        QStringLiteral("Highlighted term checked during replay, may be repeated."),
+                                        QStringLiteral("text"));
+    const QCommandLineOption diffOption(QStringLiteral("diff"),
+                                        QStringLiteral("Time the change bar diff against this baseline file."),
+                                        QStringLiteral("file"));
+    parser.addOptions({ widthOption, heightOption, dprOption, detailOption, wrapOption, tabOption,
+                        outlineGapOption, repeatOption, outputOption, goldenOption, toleranceOption,
+                        replayOption, generateOption, seedOption, saveScriptOption, checkEveryOption, termOption,
+                        diffOption });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(2);
+    }
+    const int quality = detailFromName(parser.value(detailOption));
+    if (quality < 0)
+    {
+        QTextStream(stderr) << "unknown detail " << parser.value(detailOption) << endl;
+        return 2;
+    }
+
+    const QString filePath = parser.positionalArguments().first();
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        QTextStream(stderr) << "cannot open " << filePath << endl;
+        return 2;
+    }
+
+    CoolScrollMetrics metrics;
+    QElapsedTimer timer;
+    timer.start();
+    QTextDocument document;
+    document.setPlainText(QString::fromUtf8(file.readAll()));
+
+    QFont font;
+    font.setStyleHint(QFont::Monospace);
+
+    if (parser.isSet(replayOption) || parser.isSet(generateOption))
+    {
+        ReplayOptions options;
+        options.scriptPath = parser.value(replayOption);
+        options.generateSteps = parser.value(generateOption).toInt();
+        options.seed = parser.value(seedOption).toUInt();
+        options.saveScriptPath = parser.value(saveScriptOption);
+        options.checkEvery = parser.value(checkEveryOption).toInt();
+        options.terms = parser.values(termOption);
+        options.wrapColumn = parser.value(wrapOption).toInt();
+        options.font = font;
+        options.params.size = QSize(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+        options.params.devicePixelRatio = parser.value(dprOption).toDouble();
+        options.params.tabSize = parser.value(tabOption).toInt();
+        options.params.quality = quality;
+        options.params.outlineGap = parser.value(outlineGapOption).toInt();
+
+        const int differences = replayEditSession(document, options, metrics);
+        QTextStream(stdout) << metrics.report() << endl;
+        return differences < 0 ? 2 : (differences > 0 ? 1 : 0);
+    }
+
+    CoolScrollSnapshotTracker tracker(&document);
+    const CoolScrollDocumentSnapshot snapshot = tracker.snapshot();
+    metrics.addSample(QStringLiteral("load.usec"), timer.nsecsElapsed() / 1000);
+
+    if (parser.isSet(diffOption))
+    {
+        QFile baselineFile(parser.value(diffOption));
+        if (!baselineFile.open(QIODevice::ReadOnly))
+        {
+            QTextStream(stderr) << "cannot open " << baselineFile.fileName() << endl;
+            return 2;
+        }
+        // the lines as the bar takes them: baseline split once, current text from the snapshot
+        const QVector<QString> baseline = coolScrollSplitLines(QString::fromUtf8(baselineFile.readAll()));
+        const QVector<QString> current = snapshot.texts();
+        CoolScrollDiffResult diff;
+        const int repeat = qMax(1, parser.value(repeatOption).toInt());
+        for (int i = 0; i < repeat; ++i)
+        {
+            diff = coolScrollDiff(baseline, current, i);
+            metrics.addSample(QStringLiteral("diff.usec"), diff.elapsed);
+        }
+        qint64 changedLines = 0;
+        for (const CoolScrollDiffHunk& hunk : diff.hunks)
+        {
+            changedLines += qMax(hunk.newCount, hunk.oldCount);
+        }
+        metrics.setValue(QStringLiteral("diff.baseline_lines"), baseline.size());
+        metrics.setValue(QStringLiteral("diff.current_lines"), current.size());
+        metrics.setValue(QStringLiteral("diff.hunks"), diff.hunks.size());
+        metrics.setValue(QStringLiteral("diff.changed_lines"), changedLines);
+        QTextStream(stdout) << metrics.report() << endl;
+        return 0;
+    }
+
+    timer.restart();
+    CoolScrollWrapModel wrap;
+    wrap.update(snapshot, parser.value(wrapOption).toInt(), parser.value(tabOption).toInt());
+    metrics.addSample(QStringLiteral("wrap.usec"), timer.nsecsElapsed() / 1000);
+
+    // the same geometry the scroll bar derives from its size
+    CoolScrollRenderParams params;
+    params.size = QSize(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+    params.devicePixelRatio = parser.value(dprOption).toDouble();
+    params.lineHeight = CoolScrollRenderer::lineHeight(params.size.height(), wrap.rowCount());
+    params.tabSize = wrap.tabSize();
+    params.quality = quality;
+    params.outlineGap = parser.value(outlineGapOption).toInt();
+    params.font = CoolScrollRenderer::fitFont(font, params.lineHeight, params.size.width(), &params.charWidth);
+
+    QImage image;
+    qint64 totalUsec = 0;
+    const int repeat = qMax(1, parser.value(repeatOption).toInt());
+    for (int i = 0; i < repeat; ++i)
+    {
+        CoolScrollRenderStats stats;
+        timer.restart();
+        image = CoolScrollRenderer::render(snapshot, wrap, params, &stats);
+        const qint64 elapsed = timer.nsecsElapsed() / 1000;
+        totalUsec += elapsed;
+        metrics.addSample(QStringLiteral("render.usec"), elapsed);
+        metrics.addSample(QStringLiteral("render.bands"), stats.bands);
+        metrics.addSample(QStringLiteral("render.band.max_usec"), stats.maxBandUsec);
+        if (elapsed > 0)
+        {
+            metrics.addSample(QStringLiteral("render.parallelism_pct"), 100 * stats.bandUsec / elapsed);
+        }
+    }
+
+    metrics.setValue(QStringLiteral("document.blocks"), snapshot.blockCount());
+    metrics.setValue(QStringLiteral("document.rows"), wrap.rowCount());
+    metrics.setValue(QStringLiteral("quality.detail"), CoolScrollRenderer::detail(params));
+    metrics.setValue(QStringLiteral("render.band_rows"), CoolScrollRenderer::bandRows());
+    metrics.setValue(QStringLiteral("memory.minimap.bytes"), image.byteCount());
+    metrics.setValue(QStringLiteral("memory.minimap.argb_bytes"), qint64(image.width()) * image.height() * 4);
+    // throughput over the rows which fit into the image, comparable across a corpus
+    const qint64 drawnRows = qMin(wrap.rowCount(), CoolScrollRenderer::maxLines(params));
+    metrics.setValue(QStringLiteral("render.rows_per_sec"), drawnRows * repeat * 1000000 / qMax<qint64>(1, totalUsec));
+
+    int result = 0;
+    if (parser.isSet(outputOption) && !image.save(parser.value(outputOption), "PNG"))
+    {
+        QTextStream(stderr) << "cannot write " << parser.value(outputOption) << endl;
+        result = 2;
+    }
+    if (parser.isSet(goldenOption))
+    {
+        const QString goldenPath = parser.value(goldenOption);
+        const QImage golden(goldenPath);
+        if (golden.isNull() && !QFileInfo::exists(goldenPath))
+        {
+            image.save(goldenPath, "PNG");
+            QTextStream(stderr) << "golden image created: " << goldenPath << endl;
+        }
+        else if (golden.size() != image.size())
+        {
+            QTextStream(stderr) << "golden image size differs: " << golden.width() << "x" << golden.height() << endl;
+            result = 1;
+        }
+        else
+        {
+            const qint64 differences = differentPixels(image, golden, parser.value(toleranceOption).toInt());
+            metrics.setValue(QStringLiteral("golden.different_pixels"), differences);
+            if (differences > 0) result = 1;
+        }
+    }
+
+    QTextStream(stdout) << metrics.report() << endl;
+    return result;
+}
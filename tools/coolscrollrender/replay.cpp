@@ -0,0 +1,780 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#include "replay.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QPainter>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+
+#include "coolscrolldiff.h"
+#include "coolscrolldocumentsnapshot.h"
+#include "coolscrollhighlightcoverage.h"
+#include "coolscrollmetrics.h"
+#include "coolscrollmultisearch.h"
+#include "coolscrollscheduler.h"
+#include "coolscrolltokenindex.h"
+#include "coolscrollwrapmodel.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    const int l_defaultTerms = 3;
+    const int l_minTermLength = 3;
+    const qreal l_minSelectionHeight = 1.5;
+    const char l_typedCharacters[] = "abcdefghijklmnopqrstuvwxyz_0123456789 (){};,.=";
+
+    // One line of an edit script:
+    //   insert <position> <text>
+    //   paste <position> <replaced length> <text>
+    //   remove <position> <length>
+    //   fold <block> <count>
+    //   unfold <block> <count>
+    //   undo
+    //   redo
+    // Text escapes \n, \t and \\. Positions are clamped to the document,
+    // so handwritten scripts stay valid after earlier steps.
+    struct Step
+    {
+        QString op;
+        int position = 0;
+        int length = 0;
+        QString text;
+    };
+
+    QString escaped(const QString& text)
+    {
+        QString result;
+        result.reserve(text.size());
+        for (const QChar c : text)
+        {
+            if (c == QLatin1Char('\\')) result += QLatin1String("\\\\");
+            else if (c == QLatin1Char('\n')) result += QLatin1String("\\n");
+            else if (c == QLatin1Char('\t')) result += QLatin1String("\\t");
+            else result += c;
+        }
+        return result;
+    }
+
+    QString unescaped(const QString& text)
+    {
+        QString result;
+        result.reserve(text.size());
+        for (int i = 0; i < text.size(); ++i)
+        {
+            if (text[i] == QLatin1Char('\\') && i + 1 < text.size())
+            {
+                const QChar next = text[++i];
+                if (next == QLatin1Char('n')) result += QLatin1Char('\n');
+                else if (next == QLatin1Char('t')) result += QLatin1Char('\t');
+                else result += next;
+            }
+            else
+            {
+                result += text[i];
+            }
+        }
+        return result;
+    }
+
+    QString formatStep(const Step& step)
+    {
+        if (step.op == QLatin1String("insert"))
+        {
+            return QStringLiteral("insert %1 %2").arg(step.position).arg(escaped(step.text));
+        }
+        if (step.op == QLatin1String("paste"))
+        {
+            return QStringLiteral("paste %1 %2 %3").arg(step.position).arg(step.length).arg(escaped(step.text));
+        }
+        if (step.op == QLatin1String("undo") || step.op == QLatin1String("redo"))
+        {
+            return step.op;
+        }
+        return QStringLiteral("%1 %2 %3").arg(step.op).arg(step.position).arg(step.length);
+    }
+
+    bool parseStep(const QString& line, Step& step)
+    {
+        const QString op = line.section(QLatin1Char(' '), 0, 0);
+        bool positionOk = false;
+        bool lengthOk = false;
+        step = Step();
+        step.op = op;
+        step.position = line.section(QLatin1Char(' '), 1, 1).toInt(&positionOk);
+        if (op == QLatin1String("undo") || op == QLatin1String("redo"))
+        {
+            return line.trimmed() == op;
+        }
+        if (op == QLatin1String("insert"))
+        {
+            step.text = unescaped(line.section(QLatin1Char(' '), 2));
+            return positionOk && !step.text.isEmpty();
+        }
+        step.length = line.section(QLatin1Char(' '), 2, 2).toInt(&lengthOk);
+        if (op == QLatin1String("paste"))
+        {
+            step.text = unescaped(line.section(QLatin1Char(' '), 3));
+            return positionOk && lengthOk;
+        }
+        return positionOk && lengthOk &&
+               (op == QLatin1String("remove") || op == QLatin1String("fold") || op == QLatin1String("unfold"));
+    }
+
+    // as the editor does it: one cursor edit per step, folding hides blocks
+    // and announces the new layout size without touching the text
+    void applyStep(QTextDocument& document, const Step& step)
+    {
+        const int end = document.characterCount() - 1;
+        const int position = qBound(0, step.position, end);
+        QTextCursor cursor(&document);
+        if (step.op == QLatin1String("insert"))
+        {
+            cursor.setPosition(position);
+            cursor.insertText(step.text);
+        }
+        else if (step.op == QLatin1String("paste"))
+        {
+            cursor.setPosition(position);
+            cursor.setPosition(qMin(end, position + qMax(0, step.length)), QTextCursor::KeepAnchor);
+            cursor.beginEditBlock();
+            cursor.insertText(step.text);
+            cursor.endEditBlock();
+        }
+        else if (step.op == QLatin1String("remove"))
+        {
+            cursor.setPosition(position);
+            cursor.setPosition(qMin(end, position + qMax(0, step.length)), QTextCursor::KeepAnchor);
+            cursor.removeSelectedText();
+        }
+        else if (step.op == QLatin1String("fold") || step.op == QLatin1String("unfold"))
+        {
+            const bool visible = step.op == QLatin1String("unfold");
+            QTextBlock block = document.findBlockByNumber(qBound(0, step.position, document.blockCount() - 1));
+            for (int i = 0; i < step.length && block.isValid(); ++i, block = block.next())
+            {
+                block.setVisible(visible);
+            }
+            QAbstractTextDocumentLayout* layout = document.documentLayout();
+            emit layout->documentSizeChanged(layout->documentSize());
+        }
+        else if (step.op == QLatin1String("undo"))
+        {
+            document.undo();
+        }
+        else if (step.op == QLatin1String("redo"))
+        {
+            document.redo();
+        }
+    }
+
+    // typing which mostly stays at one place, mixed with deletions, pastes
+    // of existing lines, folding and undo, reproducible from the seed
+    class SessionGenerator
+    {
+    public:
+        explicit SessionGenerator(quint32 seed) : m_random(seed), m_cursor(0) {}
+
+        Step next(const QTextDocument& document)
+        {
+            const int end = document.characterCount() - 1;
+            if (chance(10))
+            {
+                m_cursor = uniform(0, end);
+            }
+            m_cursor = qBound(0, m_cursor, end);
+
+            Step step;
+            const int roll = uniform(0, 99);
+            if (roll < 55)
+            {
+                step.op = QStringLiteral("insert");
+                step.position = m_cursor;
+                if (chance(8)) step.text = QStringLiteral("\n");
+                else if (chance(3)) step.text = QStringLiteral("\t");
+                else step.text = QChar(QLatin1Char(l_typedCharacters[uniform(0, int(sizeof(l_typedCharacters)) - 2)]));
+                m_cursor += step.text.size();
+            }
+            else if (roll < 75)
+            {
+                step.op = QStringLiteral("remove");
+                if (chance(10))
+                {
+                    const QTextBlock block = document.findBlock(m_cursor);
+                    step.position = block.position();
+                    step.length = block.length();
+                }
+                else
+                {
+                    step.position = qMax(0, m_cursor - 1);
+                    step.length = 1;
+                }
+                m_cursor = step.position;
+            }
+            else if (roll < 85)
+            {
+                step.op = QStringLiteral("paste");
+                step.position = m_cursor;
+                step.length = chance(30) ? uniform(0, 40) : 0;
+                QTextCursor source(document.findBlockByNumber(uniform(0, document.blockCount() - 1)));
+                source.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, uniform(1, 8));
+                step.text = source.selectedText().replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+                m_cursor += step.text.size();
+            }
+            else if (roll < 93)
+            {
+                step.op = chance(50) ? QStringLiteral("fold") : QStringLiteral("unfold");
+                step.position = uniform(0, document.blockCount() - 1);
+                step.length = uniform(1, 20);
+            }
+            else if (roll < 98 && document.isUndoAvailable())
+            {
+                step.op = QStringLiteral("undo");
+            }
+            else if (document.isRedoAvailable())
+            {
+                step.op = QStringLiteral("redo");
+            }
+            else
+            {
+                step.op = QStringLiteral("insert");
+                step.position = m_cursor;
+                step.text = QStringLiteral(" ");
+                m_cursor += 1;
+            }
+            return step;
+        }
+
+    private:
+
+        int uniform(int min, int max)
+        {
+            return std::uniform_int_distribution<int>(min, qMax(min, max))(m_random);
+        }
+
+        bool chance(int percent) { return uniform(0, 99) < percent; }
+
+        std::mt19937 m_random;
+        int m_cursor;
+    };
+
+    // identifiers of a snapshot with their occurrences, made without the index
+    struct FreshTokens
+    {
+        CoolScrollTokenTable table;
+        QVector<QVector<CoolScrollSearchMatch>> occurrences; // per token id
+    };
+
+    FreshTokens tokenize(const CoolScrollDocumentSnapshot& snapshot)
+    {
+        FreshTokens result;
+        QVector<CoolScrollToken> tokens;
+        for (int block = 0; block < snapshot.blockCount(); ++block)
+        {
+            result.table.tokenizeBlock(snapshot.text(block), tokens);
+            result.occurrences.resize(result.table.tokens.size());
+            for (const CoolScrollToken& token : tokens)
+            {
+                result.occurrences[token.id].push_back(
+                    CoolScrollSearchMatch { block, token.column, result.table.tokens[token.id].size(), 0 });
+            }
+        }
+        return result;
+    }
+
+    QStringList frequentIdentifiers(const CoolScrollDocumentSnapshot& snapshot)
+    {
+        const FreshTokens fresh = tokenize(snapshot);
+        QVector<int> ids;
+        for (int id = 0; id < fresh.table.tokens.size(); ++id)
+        {
+            if (fresh.table.tokens[id].size() >= l_minTermLength) ids.push_back(id);
+        }
+        std::stable_sort(ids.begin(), ids.end(), [&fresh](int a, int b) {
+            return fresh.occurrences[a].size() > fresh.occurrences[b].size();
+        });
+        QStringList terms;
+        for (int i = 0; i < qMin(l_defaultTerms, ids.size()); ++i)
+        {
+            terms << fresh.table.tokens[ids[i]];
+        }
+        return terms;
+    }
+
+    QString snapshotDifference(const CoolScrollDocumentSnapshot& incremental, const CoolScrollDocumentSnapshot& fresh)
+    {
+        if (incremental.blockCount() != fresh.blockCount())
+        {
+            return QStringLiteral("snapshot has %1 blocks instead of %2").arg(incremental.blockCount()).arg(fresh.blockCount());
+        }
+        for (int block = 0; block < fresh.blockCount(); ++block)
+        {
+            if (incremental.text(block) != fresh.text(block))
+            {
+                return QStringLiteral("text of block %1 differs").arg(block);
+            }
+            if (incremental.isVisible(block) != fresh.isVisible(block))
+            {
+                return QStringLiteral("visibility of block %1 differs").arg(block);
+            }
+            if (incremental.kind(block) != fresh.kind(block))
+            {
+                return QStringLiteral("kind of block %1 differs").arg(block);
+            }
+            const CoolScrollOutline& outline = incremental.outline(block);
+            const CoolScrollOutline& freshOutline = fresh.outline(block);
+            bool sameOutline = outline.count == freshOutline.count;
+            for (int run = 0; run < outline.count && sameOutline; ++run)
+            {
+                sameOutline = outline.starts[run] == freshOutline.starts[run]
+                        && outline.ends[run] == freshOutline.ends[run];
+            }
+            if (!sameOutline)
+            {
+                return QStringLiteral("outline of block %1 differs").arg(block);
+            }
+        }
+        return QString();
+    }
+
+    QString wrapDifference(const CoolScrollWrapModel& incremental, const CoolScrollWrapModel& fresh)
+    {
+        if (incremental.blockCount() != fresh.blockCount() || incremental.rowCount() != fresh.rowCount())
+        {
+            return QStringLiteral("wrap model has %1 rows of %2 blocks instead of %3 of %4")
+                    .arg(incremental.rowCount()).arg(incremental.blockCount())
+                    .arg(fresh.rowCount()).arg(fresh.blockCount());
+        }
+        for (int block = 0; block < fresh.blockCount(); ++block)
+        {
+            if (incremental.firstRow(block) != fresh.firstRow(block) || incremental.rows(block) != fresh.rows(block))
+            {
+                return QStringLiteral("rows of block %1 differ").arg(block);
+            }
+        }
+        return QString();
+    }
+
+    bool sameMatches(QVector<CoolScrollSearchMatch> a, QVector<CoolScrollSearchMatch> b)
+    {
+        if (a.size() != b.size()) return false;
+        const auto byPosition = [](const CoolScrollSearchMatch& x, const CoolScrollSearchMatch& y) {
+            return x.block != y.block ? x.block < y.block : x.column < y.column;
+        };
+        std::sort(a.begin(), a.end(), byPosition);
+        std::sort(b.begin(), b.end(), byPosition);
+        for (int i = 0; i < a.size(); ++i)
+        {
+            if (a[i].block != b[i].block || a[i].column != b[i].column || a[i].length != b[i].length) return false;
+        }
+        return true;
+    }
+
+    // tokens of the previous check are queried as well, they catch
+    // occurrences the index keeps after their text was removed
+    QString tokenDifference(const CoolScrollTokenIndex& index, const FreshTokens& fresh, QSet<QString>& knownTokens)
+    {
+        for (const QString& token : fresh.table.tokens)
+        {
+            knownTokens.insert(token);
+        }
+        QString difference;
+        QVector<CoolScrollSearchMatch> matches;
+        for (const QString& token : qAsConst(knownTokens))
+        {
+            matches.clear();
+            index.occurrences(token, 0, matches);
+            const int id = fresh.table.ids.value(token, -1);
+            const QVector<CoolScrollSearchMatch> expected = id >= 0 ? fresh.occurrences[id]
+                                                                    : QVector<CoolScrollSearchMatch>();
+            if (!sameMatches(matches, expected))
+            {
+                difference = QStringLiteral("token index has %1 occurrences of %2 instead of %3")
+                        .arg(matches.size()).arg(token).arg(expected.size());
+                break;
+            }
+        }
+        knownTokens.clear();
+        for (const QString& token : fresh.table.tokens)
+        {
+            knownTokens.insert(token);
+        }
+        return difference;
+    }
+
+    CoolScrollHighlightCoverage tokenCoverage(const CoolScrollSearchInput& input,
+                                              const QVector<CoolScrollSearchMatch>& matches)
+    {
+        CoolScrollHighlightCoverage areas(input.height, input.firstRow);
+        for (const CoolScrollSearchMatch& match : matches)
+        {
+            if (input.wrap.rows(match.block) > 0)
+            {
+                areas.add(coolScrollMatchRect(input, input.snapshot.text(match.block), match));
+            }
+        }
+        return areas;
+    }
+
+    QImage coverageImage(const CoolScrollHighlightCoverage& areas, const CoolScrollSearchInput& input)
+    {
+        QImage image(input.scrollBarWidth, input.height, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter p(&image);
+        areas.paint(p, Qt::black);
+        return image;
+    }
+
+    bool sameCoverage(const CoolScrollHighlightCoverage& a, const CoolScrollHighlightCoverage& b,
+                      const CoolScrollSearchInput& input)
+    {
+        return a.matchesCount() == b.matchesCount() && coverageImage(a, input) == coverageImage(b, input);
+    }
+
+    // lines outside the hunks must be the baseline lines they are aligned with
+    QString alignmentDifference(const QVector<CoolScrollDiffHunk>& hunks,
+                                const QVector<QString>& baseline, const QVector<QString>& current)
+    {
+        int oldLine = 0;
+        int newLine = 0;
+        const auto unchangedUntil = [&](int end) -> bool
+        {
+            for (; newLine < end; ++newLine, ++oldLine)
+            {
+                if (oldLine >= baseline.size() || current[newLine] != baseline[oldLine]) return false;
+            }
+            return true;
+        };
+        for (const CoolScrollDiffHunk& hunk : hunks)
+        {
+            if (hunk.newStart < newLine || hunk.newCount < 0 || hunk.oldCount < 0)
+            {
+                return QStringLiteral("hunk at line %1 is out of order").arg(hunk.newStart);
+            }
+            if (!unchangedUntil(qMin(hunk.newStart, current.size())))
+            {
+                return QStringLiteral("line %1 has no bar but differs from the baseline").arg(newLine);
+            }
+            newLine += hunk.newCount;
+            oldLine += hunk.oldCount;
+        }
+        if (newLine > current.size() || current.size() - newLine != baseline.size() - oldLine)
+        {
+            return QStringLiteral("hunks cover %1 of %2 lines").arg(newLine).arg(current.size());
+        }
+        if (!unchangedUntil(current.size()))
+        {
+            return QStringLiteral("line %1 has no bar but differs from the baseline").arg(newLine);
+        }
+        return QString();
+    }
+
+    int changedLines(const QVector<CoolScrollDiffHunk>& hunks)
+    {
+        int count = 0;
+        for (const CoolScrollDiffHunk& hunk : hunks)
+        {
+            count += hunk.newCount + hunk.oldCount;
+        }
+        return count;
+    }
+
+    // bars shifted along with the edits may mark more lines than a diff,
+    // but must not leave a changed line out; the diff is the shortest
+    QString changeDifference(const QVector<CoolScrollDiffHunk>& shifted, const QVector<CoolScrollDiffHunk>& fresh,
+                             const QVector<QString>& baseline, const QVector<QString>& current)
+    {
+        QString difference = alignmentDifference(fresh, baseline, current);
+        if (!difference.isEmpty())
+        {
+            return QStringLiteral("fresh diff: ") + difference;
+        }
+        difference = alignmentDifference(shifted, baseline, current);
+        if (!difference.isEmpty())
+        {
+            return QStringLiteral("shifted change bars: ") + difference;
+        }
+        if (changedLines(fresh) > changedLines(shifted))
+        {
+            return QStringLiteral("fresh diff changes %1 lines, the shifted change bars %2")
+                    .arg(changedLines(fresh)).arg(changedLines(shifted));
+        }
+        return QString();
+    }
+
+    qint64 percentile(const QVector<qint64>& sorted, int percent)
+    {
+        if (sorted.isEmpty()) return 0;
+        return sorted[(sorted.size() - 1) * percent / 100];
+    }
+}
+
+int replayEditSession(QTextDocument& document, const ReplayOptions& options, CoolScrollMetrics& metrics)
+{
+    QStringList script;
+    if (!options.scriptPath.isEmpty())
+    {
+        QFile file(options.scriptPath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            QTextStream(stderr) << "cannot open " << options.scriptPath << endl;
+            return -1;
+        }
+        QTextStream in(&file);
+        in.setCodec("UTF-8");
+        while (!in.atEnd())
+        {
+            const QString line = in.readLine();
+            if (!line.trimmed().isEmpty() && !line.startsWith(QLatin1Char('#'))) script << line;
+        }
+    }
+    const int stepCount = options.scriptPath.isEmpty() ? options.generateSteps : script.size();
+    const int checkEvery = qMax(1, options.checkEvery);
+
+    // what the scroll bar keeps per editor
+    CoolScrollScheduler scheduler(QSharedPointer<CoolScrollMetrics>::create());
+    CoolScrollSnapshotTracker tracker(&document);
+    CoolScrollTokenIndex tokenIndex(&tracker, &scheduler);
+    tokenIndex.setPriority(CoolScrollScheduler::ActiveEditor);
+    tokenIndex.setEnabled(true);
+    CoolScrollWrapModel wrap;
+    wrap.update(tracker.snapshot(), options.wrapColumn, options.params.tabSize);
+    // the file as loaded is the baseline, change bars are shifted with the
+    // edits and replaced by a fresh diff after every check, as the diff
+    // arriving from the worker replaces them in the bar
+    const QVector<QString> baseline = tracker.snapshot().texts();
+    CoolScrollChangeLayer changes;
+    QObject::connect(&tracker, &CoolScrollSnapshotTracker::blocksReplaced,
+                     [&changes](int first, int removed, int added)
+    {
+        changes.applyEdit(first, first + removed - 1, first + added - 1);
+    });
+
+    QVector<CoolScrollHighlightTerm> terms;
+    for (const QString& text : options.terms.isEmpty() ? frequentIdentifiers(tracker.snapshot()) : options.terms)
+    {
+        CoolScrollHighlightTerm term;
+        term.text = text;
+        terms.push_back(term);
+    }
+
+    SessionGenerator generator(options.seed);
+    QStringList executed;
+    QSet<QString> knownTokens;
+    QVector<qint64> stepUsec;
+    stepUsec.reserve(stepCount);
+    int differences = 0;
+    int checks = 0;
+
+    QElapsedTimer timer;
+    for (int i = 0; i < stepCount && differences == 0; ++i)
+    {
+        Step step;
+        if (options.scriptPath.isEmpty())
+        {
+            step = generator.next(document);
+        }
+        else if (!parseStep(script[i], step))
+        {
+            QTextStream(stderr) << "cannot parse step " << i + 1 << ": " << script[i] << endl;
+            differences = -1;
+            break;
+        }
+        executed << formatStep(step);
+
+        // the incremental path: edit with tracker and index following it,
+        // then rows and the minimap picture of the bar
+        timer.start();
+        applyStep(document, step);
+        const qint64 editUsec = timer.nsecsElapsed() / 1000;
+        const CoolScrollDocumentSnapshot snapshot = tracker.snapshot();
+        wrap.update(snapshot, options.wrapColumn, options.params.tabSize);
+        const qint64 wrapUsec = timer.nsecsElapsed() / 1000 - editUsec;
+
+        CoolScrollRenderParams params = options.params;
+        params.lineHeight = CoolScrollRenderer::lineHeight(params.size.height(), wrap.rowCount());
+        params.font = CoolScrollRenderer::fitFont(options.font, params.lineHeight, params.size.width(), &params.charWidth);
+        const qint64 renderStart = timer.nsecsElapsed() / 1000;
+        const QImage image = CoolScrollRenderer::render(snapshot, wrap, params);
+        const qint64 totalUsec = timer.nsecsElapsed() / 1000;
+
+        stepUsec.push_back(totalUsec);
+        metrics.addSample(QStringLiteral("replay.step.usec"), totalUsec);
+        metrics.addSample(QStringLiteral("replay.%1.usec").arg(step.op), totalUsec);
+        metrics.addSample(QStringLiteral("replay.edit.usec"), editUsec);
+        metrics.addSample(QStringLiteral("replay.wrap.usec"), wrapUsec);
+        metrics.addSample(QStringLiteral("replay.render.usec"), totalUsec - renderStart);
+
+        if ((i + 1) % checkEvery != 0 && i + 1 != stepCount) continue;
+
+        // the index builds on a worker after structural edits made during its first build
+        while (!tokenIndex.isReady())
+        {
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        ++checks;
+
+        CoolScrollSnapshotTracker freshTracker(&document);
+        const CoolScrollDocumentSnapshot freshSnapshot = freshTracker.snapshot();
+        CoolScrollWrapModel freshWrap;
+        freshWrap.update(freshSnapshot, options.wrapColumn, options.params.tabSize);
+
+        QString difference = snapshotDifference(snapshot, freshSnapshot);
+        if (difference.isEmpty())
+        {
+            difference = wrapDifference(wrap, freshWrap);
+        }
+        if (difference.isEmpty() && image != CoolScrollRenderer::render(freshSnapshot, freshWrap, params))
+        {
+            difference = QStringLiteral("minimap differs");
+        }
+        const FreshTokens freshTokens = tokenize(freshSnapshot);
+        if (difference.isEmpty())
+        {
+            difference = tokenDifference(tokenIndex, freshTokens, knownTokens);
+        }
+        if (difference.isEmpty())
+        {
+            const QVector<QString> current = freshSnapshot.texts();
+            const CoolScrollDiffResult diff = coolScrollDiff(baseline, current, 0);
+            difference = changeDifference(changes.hunks(), diff.hunks, baseline, current);
+            changes.setHunks(diff.hunks);
+        }
+        if (difference.isEmpty() && !terms.isEmpty())
+        {
+            CoolScrollSearchInput input;
+            input.terms = terms;
+            input.charWidth = params.charWidth;
+            input.lineHeight = params.lineHeight;
+            input.minSelectionHeight = l_minSelectionHeight;
+            input.scrollBarWidth = params.size.width();
+            input.visibleColumns = CoolScrollRenderer::visibleColumns(params.size.width(), params.charWidth);
+            input.height = params.size.height();
+            CoolScrollSearchInput freshInput = input;
+            input.snapshot = snapshot;
+            input.wrap = wrap;
+            freshInput.snapshot = freshSnapshot;
+            freshInput.wrap = freshWrap;
+
+            const CoolScrollSearchResult found = coolScrollSearch(input);
+            const CoolScrollSearchResult expected = coolScrollSearch(freshInput);
+            for (int term = 0; term < terms.size() && difference.isEmpty(); ++term)
+            {
+                if (!sameCoverage(found.areas[term], expected.areas[term], input))
+                {
+                    difference = QStringLiteral("highlights of %1 differ").arg(terms[term].text);
+                }
+                else if (CoolScrollTokenIndex::isIdentifier(terms[term].text))
+                {
+                    // the word under cursor is highlighted from the token index
+                    QVector<CoolScrollSearchMatch> matches;
+                    tokenIndex.occurrences(terms[term].text, 0, matches);
+                    const int id = freshTokens.table.ids.value(terms[term].text, -1);
+                    if (!sameCoverage(tokenCoverage(input, matches),
+                                      tokenCoverage(freshInput, id >= 0 ? freshTokens.occurrences[id]
+                                                                        : QVector<CoolScrollSearchMatch>()),
+                                      input))
+                    {
+                        difference = QStringLiteral("word highlights of %1 differ").arg(terms[term].text);
+                    }
+                }
+            }
+
+            // whole words are highlighted from the index once it is ready and
+            // scanned for before, both must give the same picture
+            QVector<CoolScrollHighlightTerm> words;
+            for (const CoolScrollHighlightTerm& term : terms)
+            {
+                if (CoolScrollTokenIndex::isIdentifier(term.text))
+                {
+                    words.push_back(term);
+                    words.last().wholeWord = true;
+                }
+            }
+            input.terms = words;
+            const CoolScrollSearchResult scanned = coolScrollSearch(input);
+            for (int word = 0; word < words.size() && difference.isEmpty(); ++word)
+            {
+                QVector<CoolScrollSearchMatch> matches;
+                tokenIndex.occurrences(words[word].text, 0, matches);
+                if (!sameCoverage(tokenCoverage(input, matches), scanned.areas[word], input))
+                {
+                    difference = QStringLiteral("index and scan highlights of %1 differ").arg(words[word].text);
+                }
+            }
+        }
+
+        if (!difference.isEmpty())
+        {
+            QTextStream(stderr) << "step " << i + 1 << " (" << executed.last() << "): " << difference << endl;
+            ++differences;
+        }
+    }
+
+    if (!options.saveScriptPath.isEmpty())
+    {
+        QFile file(options.saveScriptPath);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            QTextStream out(&file);
+            out.setCodec("UTF-8");
+            out << "# coolscrollrender edit session, seed " << options.seed << "\n";
+            for (const QString& line : executed)
+            {
+                out << line << "\n";
+            }
+        }
+        else
+        {
+            QTextStream(stderr) << "cannot write " << options.saveScriptPath << endl;
+        }
+    }
+
+    std::sort(stepUsec.begin(), stepUsec.end());
+    metrics.setValue(QStringLiteral("replay.steps"), executed.size());
+    metrics.setValue(QStringLiteral("replay.checks"), checks);
+    metrics.setValue(QStringLiteral("replay.differences"), qMax(0, differences));
+    metrics.setValue(QStringLiteral("replay.step.p50_usec"), percentile(stepUsec, 50));
+    metrics.setValue(QStringLiteral("replay.step.p90_usec"), percentile(stepUsec, 90));
+    metrics.setValue(QStringLiteral("replay.step.p99_usec"), percentile(stepUsec, 99));
+    metrics.setValue(QStringLiteral("document.blocks"), document.blockCount());
+    metrics.setValue(QStringLiteral("document.rows"), wrap.rowCount());
+    return differences;
+}
@@ -0,0 +1,64 @@
+/*
+*
+* Copyright (C) 2011 EgorZhuk
+*
+* Authors: Egor Zhuk <egor.zhuk@gmail.com>
+*
+* This file is part of CoolScroll plugin for QtCreator.
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <QFont>
+#include <QString>
+#include <QStringList>
+
+#include "coolscrollrenderer.h"
+
+class CoolScrollMetrics;
+class QTextDocument;
+
+struct ReplayOptions
+{
+    QString scriptPath;          // recorded session, replayed when set
+    int generateSteps = 0;       // otherwise the length of a random session
+    quint32 seed = 1;
+    QString saveScriptPath;      // executed steps are written here
+    int checkEvery = 1;          // steps between comparisons, the last step is always checked
+    QStringList terms;           // highlighted, the most frequent identifiers when empty
+    int wrapColumn = 0;
+    QFont font;                  // fitted to the line height of every step
+    CoolScrollRenderParams params; // size, device pixel ratio, tab size, quality and outline gap
+};
+
+// Applies an edit session to the document step by step while the snapshot
+// tracker, the wrap model and the token index follow it incrementally, as
+// they do in the editor. After checked steps minimap, rows, highlights and
+// change bars are compared with a from-scratch computation, and whole word
+// highlights from the index with a scan; the session stops at the first
+// difference. Returns the number of differing steps (0 or 1),
+// -1 when the script cannot be read.
+int replayEditSession(QTextDocument& document, const ReplayOptions& options, CoolScrollMetrics& metrics);
+
+#endif // REPLAY_H